@@ -0,0 +1,48 @@
+// Helpers shared by the headless benchmarks.
+//
+// Each result is printed as one JSON object per line so that runs from
+// different builds can be collected and compared by a script.
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static FILE *bench_out;
+
+static inline double bench_seconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_nsec / 1000000000 + (double)t.tv_sec;
+}
+
+// Keeps results on stdout but sends everything else the player code
+// prints there to /dev/null.
+static inline void bench_quiet(void)
+{
+  int null = open("/dev/null", O_WRONLY);
+  fflush(stdout);
+  bench_out = fdopen(dup(STDOUT_FILENO), "w");
+  if (null >= 0)
+  {
+    dup2(null, STDOUT_FILENO);
+    close(null);
+  }
+}
+
+static inline void bench_report(const char *name, double value, const char *unit)
+{
+  FILE *out = bench_out != NULL ? bench_out : stdout;
+  fprintf(out, "{\"bench\": \"%s\", \"value\": %.6g, \"unit\": \"%s\"}\n", name, value, unit);
+  fflush(out);
+}
+
+// For checksums and counts, which must compare exactly between builds.
+static inline void bench_report_count(const char *name, long long value, const char *unit)
+{
+  FILE *out = bench_out != NULL ? bench_out : stdout;
+  fprintf(out, "{\"bench\": \"%s\", \"value\": %lld, \"unit\": \"%s\"}\n", name, value, unit);
+  fflush(out);
+}
@@ -0,0 +1,186 @@
+// Micro-benchmarks for the per-frame bookkeeping on the render and decode
+// paths. Each reports nanoseconds per operation.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "framecache.h"
+#include "imagecache.h"
+#include "fade.h"
+#include "trace.h"
+#include "text.h"
+
+#define ITERATIONS 1000000
+#define OVERLAY_FRAMES 100000
+
+static volatile float sink;
+
+static void report_ns(const char *name, double start, int iterations)
+{
+  bench_report(name, (bench_seconds() - start) * 1e9 / iterations, "ns/op");
+}
+
+static void bench_frame_cache(void)
+{
+  FRAME_CACHE_T cache;
+  int i, slots = frame_cache_init(&cache, 1920 * 1080 * 4, 64 * 1024 * 1024, 4.0);
+
+  for (i = 0; i < slots; i++)
+    frame_cache_add_slot(&cache, i + 1, NULL);
+
+  double start = bench_seconds();
+  for (i = 0; i < ITERATIONS; i++)
+  {
+    int slot = frame_cache_acquire(&cache, i * 0.04);
+    frame_cache_complete(&cache, slot, i * 0.04);
+    frame_cache_pin(&cache, frame_cache_newest(&cache));
+  }
+  report_ns("frame_cache_decode_cycle", start, ITERATIONS);
+
+  long newest = frame_cache_frame(&cache, frame_cache_newest(&cache));
+  start = bench_seconds();
+  for (i = 0; i < ITERATIONS; i++)
+    sink = frame_cache_lookup(&cache, newest - (i % slots));
+  report_ns("frame_cache_lookup", start, ITERATIONS);
+
+  frame_cache_destroy(&cache);
+}
+
+static unsigned int fake_upload(void *userdata, const IMAGE_T *image)
+{
+  return 1;
+}
+
+static void fake_release(void *userdata, unsigned int tex)
+{
+}
+
+static void bench_image_cache(void)
+{
+  IMAGE_CACHE_T cache;
+  IMAGE_T image;
+  char paths[64][IMAGE_PATH_MAX];
+  unsigned char pixel[4];
+  int i;
+
+  image_cache_init(&cache, 16 * 4, fake_upload, fake_release, NULL);
+  memset(&image, 0, sizeof(image));
+  image.width = 1;
+  image.height = 1;
+  image.pixels = pixel;
+  for (i = 0; i < 64; i++)
+    snprintf(paths[i], IMAGE_PATH_MAX, "/shows/stills/slide%02d.png", i);
+
+  double start = bench_seconds();
+  for (i = 0; i < ITERATIONS; i++)
+  {
+    const char *path = paths[i % 64];
+    if (image_cache_get(&cache, path) == NULL)
+    {
+      strcpy(image.path, path);
+      image_cache_insert(&cache, &image, 0);
+    }
+  }
+  report_ns("image_cache_get_insert", start, ITERATIONS);
+  image_cache_destroy(&cache);
+}
+
+static void bench_fade(void)
+{
+  FADE_DATA_T fade;
+  float alpha = 1.0f;
+  int i;
+
+  fade_start(&fade, 0.0f, 1e-9f, alpha, 0.0);
+  double start = bench_seconds();
+  for (i = 0; i < ITERATIONS; i++)
+    alpha = fade_update(&fade, alpha, i * 1e-6);
+  report_ns("fade_update", start, ITERATIONS);
+  sink = alpha;
+}
+
+static void bench_trace(void)
+{
+  char path[] = "/tmp/micro_traceXXXXXX";
+  int fd = mkstemp(path), i;
+
+  if (fd < 0)
+    return;
+  close(fd);
+
+  trace_open(path);
+  double start = bench_seconds();
+  for (i = 0; i < ITERATIONS; i++)
+    trace_record(TRACE_FRAME, i, i);
+  trace_close();
+  report_ns("trace_record", start, ITERATIONS);
+  unlink(path);
+
+  // and the cost when recording is off
+  start = bench_seconds();
+  for (i = 0; i < ITERATIONS; i++)
+    trace_record(TRACE_FRAME, i, i);
+  report_ns("trace_record_disabled", start, ITERATIONS);
+}
+
+// The player's rehearsal overlay: four strings set every frame, with the
+// timecode and sync error changing each frame and the rest not.
+static void bench_text(void)
+{
+  TEXT_LAYER_T *layer = malloc(sizeof(TEXT_LAYER_T));
+  char timecode[32];
+  int i;
+
+  double start = bench_seconds();
+  for (i = 0; i < 100; i++)
+  {
+    text_atlas_init(&layer->atlas, 3);
+    text_atlas_destroy(&layer->atlas);
+  }
+  bench_report("text_atlas_build", (bench_seconds() - start) * 1e6 / 100, "us");
+
+  text_layer_init(layer, 3);
+  int cue = text_layer_add(layer, 12, 12);
+  int tc = text_layer_add(layer, 12, 39);
+  int dropped = text_layer_add(layer, 12, 66);
+  int sync = text_layer_add(layer, 12, 93);
+
+  start = bench_seconds();
+  for (i = 0; i < OVERLAY_FRAMES; i++)
+  {
+    text_layer_printf(layer, cue, "Cue %g", 12.5);
+    text_timecode(timecode, sizeof(timecode), i, 25);
+    text_layer_printf(layer, tc, "TC %s", timecode);
+    text_layer_printf(layer, dropped, "Dropped %lu", 0UL);
+    text_layer_printf(layer, sync, "Sync %+.1f ms", (i % 7) * 0.3);
+  }
+  report_ns("text_overlay_frame", start, OVERLAY_FRAMES);
+
+  start = bench_seconds();
+  for (i = 0; i < OVERLAY_FRAMES; i++)
+  {
+    text_layer_printf(layer, cue, "Cue %g", 12.5);
+    text_layer_printf(layer, tc, "TC %s", timecode);
+    text_layer_printf(layer, dropped, "Dropped %lu", 0UL);
+    text_layer_printf(layer, sync, "Sync %+.1f ms", 0.0);
+  }
+  report_ns("text_overlay_frame_unchanged", start, OVERLAY_FRAMES);
+  bench_report_count("text_overlay_vertices", text_layer_vertex_count(layer), "vertices");
+
+  text_layer_destroy(layer);
+  free(layer);
+}
+
+int main(int argc, char **argv)
+{
+  bench_quiet();
+  bench_frame_cache();
+  bench_image_cache();
+  bench_fade();
+  bench_trace();
+  bench_text();
+  return 0;
+}
@@ -0,0 +1,223 @@
+// Measures how the decoder recovers from a wedged or failing pipeline.
+//
+// The decoder plays a synthetic stream through the stub OMX backend while
+// this thread stands in for the renderer, following the newest frame. Each
+// run injects one fault and reports how long the watchdog took to notice,
+// how long from then until a frame came out of the rebuilt pipeline, and
+// how far the first new picture is from the one after the last picture
+// shown before the fault (0 is a seamless resume). When the old pipeline
+// hangs in teardown, the restart time includes the teardown deadline.
+// One run plays the stream as a compiled show's clip and reloads the show
+// before the fault, so the restart reopens the clip after the show it was
+// named by has been unmapped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "show.h"
+#include "showcompile.h"
+#include "stub_omx.h"
+#include "video.h"
+
+#define CACHE_SLOTS 4
+#define STREAM_PICTURES 4000
+#define STREAM_GOP 25
+#define PICTURE_BYTES 2000
+#define INPUT_BUFFER_BYTES 16384
+#define FRAME_MICROS 2000
+#define FAULT_AFTER_BUFFERS 60
+#define WATCHDOG_TIMEOUT 0.25
+// frames to watch after recovering before stopping
+#define FRAMES_AFTER_RECOVERY 10
+#define RUN_TIMEOUT 10.0
+#define POLL_MICROS 500
+
+typedef struct
+{
+  const char *name;
+  int fault;
+  // play the stream from a show and reload the show before the fault
+  int reload;
+} FAULT_T;
+
+static const FAULT_T faults[] =
+{
+  { "input_stall", STUB_FAULT_INPUT_STALL, 0 },
+  { "output_stall", STUB_FAULT_OUTPUT_STALL, 0 },
+  { "empty_error", STUB_FAULT_EMPTY_ERROR, 0 },
+  { "fill_error", STUB_FAULT_FILL_ERROR, 0 },
+  { "teardown_hang", STUB_FAULT_TEARDOWN_HANG, 0 },
+  { "reload_input_stall", STUB_FAULT_INPUT_STALL, 1 },
+};
+
+static char showPath[] = "/tmp/recovery_showXXXXXX";
+
+static void report(const char *fault, const char *what, double value, const char *unit)
+{
+  char metric[128];
+  snprintf(metric, sizeof(metric), "recovery_%s_%s", fault, what);
+  bench_report(metric, value, unit);
+}
+
+static void report_count(const char *fault, const char *what, long long value, const char *unit)
+{
+  char metric[128];
+  snprintf(metric, sizeof(metric), "recovery_%s_%s", fault, what);
+  bench_report_count(metric, value, unit);
+}
+
+// A show with one cue whose clip is the stream.
+static int write_show(const char *streamPath)
+{
+  char *text = NULL;
+  size_t length, size;
+  void *image;
+  int fd;
+
+  if ((fd = mkstemp(showPath)) < 0)
+    return -1;
+  close(fd);
+  FILE *out = open_memstream(&text, &length);
+  fprintf(out, "clip main %s\ncue 1 clip=main\n", streamPath);
+  fclose(out);
+  FILE *in = fmemopen(text, length, "r");
+  int errors = show_compile(in, "recovery", &image, &size);
+  fclose(in);
+  free(text);
+  if (errors > 0)
+    return -1;
+  int status = show_write(showPath, image, size);
+  free(image);
+  return status;
+}
+
+static int run(const FAULT_T *fault, char *streamPath)
+{
+  VIDEO_THREAD_DATA_T video;
+  FRAME_CACHE_T cache;
+  WATCHDOG_STATS_T stats;
+  SHOW_T shows[2], *show = NULL;
+  pthread_t thread;
+  char *videoPath = streamPath;
+  long shown = -1, lastBefore = -1, firstAfter = -1;
+  int i, framesAfter = 0;
+
+  if (fault->reload)
+  {
+    if (show_load(&shows[0], showPath) != 0 || (videoPath = show_video_path(&shows[0])) == NULL)
+    {
+      fprintf(stderr, "%s: could not load %s\n", fault->name, showPath);
+      return -1;
+    }
+    show = &shows[0];
+  }
+
+  stub_omx_reset();
+  stub_omx_config.inputBufferSize = INPUT_BUFFER_BYTES;
+  stub_omx_config.frameMicros = FRAME_MICROS;
+  stub_omx_config.onInput = NULL;
+  stub_omx_config.pictureFrames = 1;
+  stub_omx_config.fault = fault->fault;
+  stub_omx_config.faultAfterBuffers = FAULT_AFTER_BUFFERS;
+
+  frame_cache_init(&cache, 1, CACHE_SLOTS, 1.0);
+  for (i = 0; i < CACHE_SLOTS; i++)
+    frame_cache_add_slot(&cache, 0, NULL);
+  video_init(&video, videoPath, &cache);
+  video.watchdog.inputTimeout = WATCHDOG_TIMEOUT;
+  video.watchdog.outputTimeout = WATCHDOG_TIMEOUT;
+  video.watchdog.teardownTimeout = WATCHDOG_TIMEOUT;
+  video_textures_ready(&video);
+  pthread_create(&thread, NULL, video_decode_main, &video);
+
+  double start = bench_seconds();
+  while (video.state != VIDEO_STATE_TERMINATED && framesAfter < FRAMES_AFTER_RECOVERY)
+  {
+    if (bench_seconds() - start > RUN_TIMEOUT)
+      break;
+
+    int slot = frame_cache_newest(&cache);
+    if (slot >= 0 && frame_cache_frame(&cache, slot) != shown)
+    {
+      // hold on to it the way the renderer does
+      frame_cache_pin(&cache, slot);
+      shown = frame_cache_frame(&cache, slot);
+      int pipeline;
+      long picture = stub_omx_buffer_picture(slot, &pipeline);
+      // the player's SIGHUP path: load the spare slot, unmap the old one
+      if (show == &shows[0] && show_load(&shows[1], showPath) == 0)
+      {
+        show_unload(&shows[0]);
+        show = &shows[1];
+      }
+      if (pipeline < 2)
+        lastBefore = picture;
+      else
+      {
+        if (firstAfter < 0)
+          firstAfter = picture;
+        framesAfter++;
+      }
+    }
+    usleep(POLL_MICROS);
+  }
+
+  video.command = VIDEO_COMMAND_TERMINATE;
+  pthread_join(thread, NULL);
+  watchdog_get_stats(&video.watchdog, &stats);
+  if (show != NULL)
+  {
+    show_unload(show);
+    free(videoPath);
+  }
+
+  if (stats.recoveries == 0 || firstAfter < 0)
+  {
+    fprintf(stderr, "%s: decoder did not recover\n", fault->name);
+    frame_cache_destroy(&cache);
+    return -1;
+  }
+
+  report(fault->name, "detect", 1000.0 * (video.watchdog.firedSeconds - stub_omx_stats.faultSeconds), "ms");
+  report(fault->name, "restart", 1000.0 * stats.lastRecoverySeconds, "ms");
+  report_count(fault->name, "position_error", firstAfter - (lastBefore + 1), "frames");
+  if (fault->fault == STUB_FAULT_TEARDOWN_HANG)
+    report_count(fault->name, "abandoned", stats.abandoned, "pipelines");
+  frame_cache_destroy(&cache);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  char streamPath[] = "/tmp/recoveryXXXXXX";
+  int fd, status = 0;
+  unsigned int i;
+
+  if ((fd = mkstemp(streamPath)) < 0)
+  {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+  if (stub_omx_write_stream(streamPath, STREAM_PICTURES, STREAM_GOP, PICTURE_BYTES) != 0 ||
+      write_show(streamPath) != 0)
+  {
+    unlink(streamPath);
+    return 1;
+  }
+
+  bench_quiet();
+  for (i = 0; i < sizeof(faults) / sizeof(faults[0]); i++)
+  {
+    if (run(&faults[i], streamPath) != 0)
+      status = 1;
+  }
+
+  unlink(streamPath);
+  unlink(showPath);
+  return status;
+}
@@ -0,0 +1,435 @@
+// Replays session traces against the stub OMX backend.
+//
+// The decoder's input loop is re-run on this thread with every command
+// applied at the same point in the stream as it was recorded, and the
+// reads, rewinds and commands it produces are compared with the trace.
+// The fades are re-run against the recorded frame times and compared with
+// the recorded alpha. Frame timing statistics come straight from the trace.
+//
+// Usage: replay.bin [trace ...]
+// With no traces a synthetic session is recorded first and replayed, then
+// its fades are replayed again moved to straddle the point where a 32-bit
+// microsecond timestamp would wrap.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "stub_omx.h"
+#include "video.h"
+#include "fade.h"
+#include "trace.h"
+
+#define CACHE_SLOTS 4
+#define SYNTHETIC_FILE_BYTES (1024 * 1024)
+#define SYNTHETIC_BUFFER_BYTES 81920
+#define SYNTHETIC_MAX_PASSES 5000
+#define RENDER_PASS_MICROS 4000
+// 2^32 microseconds, about 71.6 minutes into a session
+#define WRAP_MICROS 4294967296ULL
+
+static VIDEO_THREAD_DATA_T video;
+static FRAME_CACHE_T cache;
+static TRACE_T replaying;
+static int nextCommand;
+static int lastSeq;
+
+static void write_input_file(const char *path, long long size)
+{
+  FILE *out = fopen(path, "wb");
+  unsigned char block[4096];
+  long long written = 0;
+  int i;
+
+  while (written < size)
+  {
+    int n = size - written < (long long)sizeof(block) ? (int)(size - written) : (int)sizeof(block);
+    for (i = 0; i < n; i++)
+      block[i] = (unsigned char)(((written + i) * 2654435761u) >> 24);
+    fwrite(block, 1, n, out);
+    written += n;
+  }
+  fclose(out);
+}
+
+static void setup_decoder(char *filename)
+{
+  int i;
+
+  frame_cache_init(&cache, 1, CACHE_SLOTS, 1.0);
+  for (i = 0; i < CACHE_SLOTS; i++)
+    frame_cache_add_slot(&cache, 0, NULL);
+  video_init(&video, filename, &cache);
+  video_textures_ready(&video);
+}
+
+// Records a short scripted session the way the player would: the decoder
+// on its own thread, commands and fades from a render loop.
+static int record_synthetic(const char *tracePath, char *inputPath)
+{
+  pthread_t thread;
+  FADE_DATA_T fade;
+  float alpha = 1.0f;
+  int pass;
+
+  write_input_file(inputPath, SYNTHETIC_FILE_BYTES);
+  stub_omx_reset();
+  stub_omx_config.inputBufferSize = SYNTHETIC_BUFFER_BYTES;
+  stub_omx_config.buffersPerFrame = 1;
+  stub_omx_config.frameMicros = 2000;
+  stub_omx_config.onInput = NULL;
+
+  if (trace_open(tracePath) != 0)
+    return -1;
+  setup_decoder(inputPath);
+  pthread_create(&thread, NULL, video_decode_main, &video);
+
+  fade_start(&fade, 0.0f, 2.0f, alpha, bench_seconds());
+  trace_record(TRACE_FADE, 0, 2000000);
+
+  for (pass = 0; video.state != VIDEO_STATE_TERMINATED; pass++)
+  {
+    if (pass == 40)
+      video.command = VIDEO_COMMAND_PAUSE;
+    else if (pass == 60)
+      video.command = VIDEO_COMMAND_PLAY;
+    else if (pass == 100)
+    {
+      fade_start(&fade, 1.0f, 4.0f, alpha, bench_seconds());
+      trace_record(TRACE_FADE, 1000000, 4000000);
+    }
+    else if (pass == 120)
+      video.command = VIDEO_COMMAND_DEVAMP;
+    else if (pass == SYNTHETIC_MAX_PASSES)
+      video.command = VIDEO_COMMAND_TERMINATE;
+
+    alpha = fade_update(&fade, alpha, bench_seconds());
+    int slot = frame_cache_newest(&cache);
+    if (slot >= 0)
+      frame_cache_pin(&cache, slot);
+    trace_record(TRACE_FRAME, frame_cache_frame(&cache, slot), (int32_t)(alpha * 1000000));
+    usleep(RENDER_PASS_MICROS);
+  }
+
+  pthread_join(thread, NULL);
+  trace_close();
+  frame_cache_destroy(&cache);
+  return 0;
+}
+
+static int apply_next_command(int fed)
+{
+  int i;
+
+  for (i = nextCommand; i < replaying.count; i++)
+  {
+    TRACE_RECORD_T *r = &replaying.records[i];
+    if (r->type != TRACE_COMMAND)
+      continue;
+    if (r->b > fed)
+      return 0;
+    video.command = r->a;
+    nextCommand = i + 1;
+    return 1;
+  }
+  return 0;
+}
+
+static void replay_on_input(int fed)
+{
+  if (fed > lastSeq)
+    video.command = VIDEO_COMMAND_TERMINATE;
+  else
+    apply_next_command(fed);
+}
+
+static void replay_idle(void *arg)
+{
+  if (!apply_next_command(stub_omx_stats.buffersEmptied))
+    video.command = VIDEO_COMMAND_TERMINATE;
+}
+
+static int is_input_record(const TRACE_RECORD_T *r)
+{
+  return r->type == TRACE_READ || r->type == TRACE_REWIND || r->type == TRACE_COMMAND;
+}
+
+// Compares the input-side records of two traces, ignoring timestamps. A
+// replay may end with an extra TERMINATE if the recording was cut short.
+static int count_input_mismatches(TRACE_T *expected, TRACE_T *actual)
+{
+  int i = 0, j = 0, mismatches = 0;
+
+  while (i < expected->count || j < actual->count)
+  {
+    if (i < expected->count && !is_input_record(&expected->records[i]))
+    {
+      i++;
+      continue;
+    }
+    if (j < actual->count && !is_input_record(&actual->records[j]))
+    {
+      j++;
+      continue;
+    }
+    if (i == expected->count)
+      break;
+    if (j == actual->count)
+    {
+      mismatches++;
+      i++;
+      continue;
+    }
+
+    TRACE_RECORD_T *e = &expected->records[i++], *a = &actual->records[j++];
+    if (e->type != a->type || e->a != a->a || e->b != a->b)
+      mismatches++;
+  }
+  return mismatches;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+static void replay_fades(TRACE_T *trace, const char *name)
+{
+  FADE_DATA_T fade;
+  float alpha = 1.0f;
+  double *intervals = malloc(trace->count * sizeof(double));
+  double last = -1, total = 0;
+  int i, frames = 0, count = 0, mismatches = 0;
+  char metric[128];
+
+  memset(&fade, 0, sizeof(fade));
+  fade.speed = -1;
+
+  for (i = 0; i < trace->count; i++)
+  {
+    TRACE_RECORD_T *r = &trace->records[i];
+    double t = r->micros / 1000000.0;
+
+    if (r->type == TRACE_FADE)
+      fade_start(&fade, r->a / 1000000.0f, r->b / 1000000.0f, alpha, t);
+    else if (r->type == TRACE_FRAME)
+    {
+      float speed = fade.speed > 0 ? fade.speed : 0;
+      alpha = fade_update(&fade, alpha, t);
+      // the player timed the fade a moment before recording the frame
+      if (fabs(alpha - r->b / 1000000.0) > 0.001 + speed * 0.001)
+        mismatches++;
+      if (last >= 0)
+      {
+        intervals[count++] = t - last;
+        total += t - last;
+      }
+      last = t;
+      frames++;
+    }
+  }
+
+  snprintf(metric, sizeof(metric), "replay_%s_fade_mismatches", name);
+  bench_report_count(metric, mismatches, "frames");
+  snprintf(metric, sizeof(metric), "replay_%s_frames", name);
+  bench_report_count(metric, frames, "frames");
+
+  if (count > 0)
+  {
+    qsort(intervals, count, sizeof(double), compare_doubles);
+    double median = intervals[count / 2];
+    int late = 0;
+    for (i = 0; i < count; i++)
+    {
+      if (intervals[i] > median * 1.5)
+        late++;
+    }
+
+    snprintf(metric, sizeof(metric), "replay_%s_frame_interval_mean", name);
+    bench_report(metric, 1000.0 * total / count, "ms");
+    snprintf(metric, sizeof(metric), "replay_%s_frame_interval_p99", name);
+    bench_report(metric, 1000.0 * intervals[(count * 99) / 100], "ms");
+    snprintf(metric, sizeof(metric), "replay_%s_late_frames", name);
+    bench_report_count(metric, late, "frames");
+  }
+  free(intervals);
+}
+
+static int write_trace(const char *path, const TRACE_T *trace)
+{
+  TRACE_HEADER_T header;
+  FILE *out = fopen(path, "wb");
+
+  if (out == NULL)
+    return -1;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TRACE_MAGIC, 4);
+  header.version = TRACE_VERSION;
+  header.recordSize = sizeof(TRACE_RECORD_T);
+  fwrite(&header, sizeof(header), 1, out);
+  fwrite(trace->records, sizeof(TRACE_RECORD_T), trace->count, out);
+  return fclose(out) == 0 ? 0 : -1;
+}
+
+// Replays the fades of a trace as if it had been recorded over an hour
+// into a show, with the point where 32 bits of microseconds would wrap in
+// the middle of it, after a round trip through a file.
+static int replay_long_session(const char *path, const char *dir)
+{
+  char shiftedPath[256];
+  TRACE_T trace, shifted;
+  int i;
+
+  if (trace_load(path, &trace) != 0 || trace.count == 0)
+    return -1;
+  uint64_t offset = WRAP_MICROS - trace.records[trace.count - 1].micros / 2;
+  for (i = 0; i < trace.count; i++)
+    trace.records[i].micros += offset;
+
+  snprintf(shiftedPath, sizeof(shiftedPath), "%s/long.trc", dir);
+  int status = write_trace(shiftedPath, &trace);
+  trace_free(&trace);
+  if (status != 0 || trace_load(shiftedPath, &shifted) != 0)
+  {
+    unlink(shiftedPath);
+    return -1;
+  }
+
+  replay_fades(&shifted, "long_session");
+  trace_free(&shifted);
+  unlink(shiftedPath);
+  return 0;
+}
+
+/***********************************************************
+ * Name: replay
+ *
+ * Arguments:
+ *       const char *path - trace to replay
+ *       const char *name - name used in the results
+ *       const char *dir - scratch directory
+ *
+ * Description:   Replays one trace and reports whether the decoder
+ *                input loop and the fades reproduced it, how fast the
+ *                input loop ran against the stub, and the recorded
+ *                frame timing
+ *
+ * Returns: int - 0 if the trace could be replayed
+ *
+ ***********************************************************/
+static int replay(const char *path, const char *name, const char *dir)
+{
+  char inputPath[256], outputPath[256], metric[128];
+  TRACE_T rerecorded;
+  long long fileSize = -1;
+  int i, inputSize = SYNTHETIC_BUFFER_BYTES;
+
+  if (trace_load(path, &replaying) != 0)
+  {
+    fprintf(stderr, "Could not load trace %s\n", path);
+    return -1;
+  }
+
+  lastSeq = 0;
+  for (i = 0; i < replaying.count; i++)
+  {
+    TRACE_RECORD_T *r = &replaying.records[i];
+    if (r->type == TRACE_FILE && fileSize < 0)
+      fileSize = (uint32_t)r->a | ((long long)r->b << 32);
+    else if (r->type == TRACE_INPUT)
+      inputSize = r->a;
+    else if (is_input_record(r) && r->b > lastSeq)
+      lastSeq = r->b;
+  }
+  if (fileSize < 0)
+  {
+    fprintf(stderr, "Trace %s has no input file record\n", path);
+    trace_free(&replaying);
+    return -1;
+  }
+
+  snprintf(inputPath, sizeof(inputPath), "%s/replay.h264", dir);
+  snprintf(outputPath, sizeof(outputPath), "%s/replay.trc", dir);
+  write_input_file(inputPath, fileSize);
+
+  stub_omx_reset();
+  stub_omx_config.inputBufferSize = inputSize;
+  stub_omx_config.buffersPerFrame = 1;
+  stub_omx_config.frameMicros = 0;
+  stub_omx_config.onInput = replay_on_input;
+  nextCommand = 0;
+
+  setup_decoder(inputPath);
+  video.idle = replay_idle;
+  trace_open(outputPath);
+
+  double start = bench_seconds();
+  video_decode_main(&video);
+  double elapsed = bench_seconds() - start;
+
+  trace_close();
+  frame_cache_destroy(&cache);
+
+  if (trace_load(outputPath, &rerecorded) == 0)
+  {
+    snprintf(metric, sizeof(metric), "replay_%s_input_mismatches", name);
+    bench_report_count(metric, count_input_mismatches(&replaying, &rerecorded), "records");
+    trace_free(&rerecorded);
+  }
+  snprintf(metric, sizeof(metric), "replay_%s_buffers", name);
+  bench_report_count(metric, stub_omx_stats.buffersEmptied, "buffers");
+  snprintf(metric, sizeof(metric), "replay_%s_input_checksum", name);
+  bench_report_count(metric, stub_omx_stats.checksum, "fnv1a");
+  snprintf(metric, sizeof(metric), "replay_%s_feed_throughput", name);
+  bench_report(metric, stub_omx_stats.bytes / elapsed / (1024 * 1024), "MB/s");
+
+  replay_fades(&replaying, name);
+
+  trace_free(&replaying);
+  unlink(inputPath);
+  unlink(outputPath);
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  char dir[] = "/tmp/replayXXXXXX";
+  char tracePath[256], inputPath[256], name[64];
+  int i, status = 0;
+
+  if (mkdtemp(dir) == NULL)
+  {
+    perror("mkdtemp");
+    return 1;
+  }
+  bench_quiet();
+
+  if (argc < 2)
+  {
+    snprintf(tracePath, sizeof(tracePath), "%s/synthetic.trc", dir);
+    snprintf(inputPath, sizeof(inputPath), "%s/synthetic.h264", dir);
+    if (record_synthetic(tracePath, inputPath) != 0 || replay(tracePath, "synthetic", dir) != 0 ||
+        replay_long_session(tracePath, dir) != 0)
+      status = 1;
+    unlink(tracePath);
+    unlink(inputPath);
+  }
+
+  for (i = 1; i < argc; i++)
+  {
+    const char *base = strrchr(argv[i], '/') != NULL ? strrchr(argv[i], '/') + 1 : argv[i];
+    snprintf(name, sizeof(name), "%s", base);
+    if (strchr(name, '.') != NULL)
+      *strchr(name, '.') = '\0';
+    if (replay(argv[i], name, dir) != 0)
+      status = 1;
+  }
+
+  rmdir(dir);
+  return status;
+}
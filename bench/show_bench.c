@@ -0,0 +1,218 @@
+// Compiled show benchmark: compiles synthetic shows of increasing size and
+// reports compile time, image size, load time, the show mapping's resident
+// memory after loading and after walking every cue, and the reload swap
+// time. Also times turning away a large video, which the player is
+// usually given.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "show.h"
+#include "showcompile.h"
+
+#define LOADS 1000
+#define MESH_SIDE 64
+#define LUT_SIDE 33
+
+static volatile float sink;
+
+// Resident kilobytes of the mapping starting at base, from its Rss: line
+// in /proc/self/smaps, so only pages of the show itself are counted. -1 if
+// the mapping is not found.
+static long mapping_resident_kb(const void *base)
+{
+  FILE *f = fopen("/proc/self/smaps", "r");
+  char line[512];
+  unsigned long start, end;
+  long resident = -1;
+  int found = 0;
+
+  if (f == NULL)
+    return -1;
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    if (sscanf(line, "%lx-%lx ", &start, &end) == 2)
+      found = start == (unsigned long)base;
+    else if (found && sscanf(line, "Rss: %ld kB", &resident) == 1)
+      break;
+  }
+  fclose(f);
+  return resident;
+}
+
+// A show with cues cues, a clip per ten cues, and a curve, a 64x64 mesh
+// and a 33^3 LUT per thousand cues.
+static char *write_show(int cues, size_t *length)
+{
+  char *text = NULL;
+  FILE *out = open_memstream(&text, length);
+  int clips = cues / 10 + 1, tables = cues / 1000 + 1;
+  int i, j;
+
+  for (i = 0; i < clips; i++)
+    fprintf(out, "clip clip%d media/clip%d.mp4\n", i, i);
+  for (i = 0; i < tables; i++)
+  {
+    fprintf(out, "curve curve%d 0 0 0.25 0.1 0.75 0.9 1 1\n", i);
+    fprintf(out, "mesh mesh%d %d %d", i, MESH_SIDE, MESH_SIDE);
+    for (j = 0; j < MESH_SIDE * MESH_SIDE; j++)
+    {
+      float u = (float)(j % MESH_SIDE) / (MESH_SIDE - 1), v = (float)(j / MESH_SIDE) / (MESH_SIDE - 1);
+      fprintf(out, " %g %g %g %g", u * 2 - 1, v * 2 - 1, u, v);
+    }
+    fprintf(out, "\nlut lut%d %d", i, LUT_SIDE * LUT_SIDE * LUT_SIDE);
+    for (j = 0; j < LUT_SIDE * LUT_SIDE * LUT_SIDE; j++)
+      fprintf(out, " %g %g %g", (float)(j % LUT_SIDE) / (LUT_SIDE - 1),
+              (float)(j / LUT_SIDE % LUT_SIDE) / (LUT_SIDE - 1), (float)(j / LUT_SIDE / LUT_SIDE) / (LUT_SIDE - 1));
+    fprintf(out, "\n");
+  }
+  for (i = 0; i < cues; i++)
+  {
+    fprintf(out, "cue %d still=slides/cue%d.png alpha=%g fade=%g", i + 1, i, (i % 5) / 4.0, (i % 3) * 0.5);
+    if (i % 10 == 0)
+      fprintf(out, " clip=clip%d", i / 10);
+    if (i % 1000 == 0)
+      fprintf(out, " mesh=mesh%d lut=lut%d", i / 1000, i / 1000);
+    if (i % 4 == 0)
+      fprintf(out, " curve=curve%d", i / 1000);
+    fprintf(out, "\n");
+  }
+  fclose(out);
+  return text;
+}
+
+static void load_failed(const char *path)
+{
+  fprintf(stderr, "could not load %s\n", path);
+  exit(1);
+}
+
+static void bench_show(int cues)
+{
+  char name[64], path[256];
+  size_t length, size;
+  void *image;
+  SHOW_T shows[2];
+  int i;
+
+  char *text = write_show(cues, &length);
+  FILE *in = fmemopen(text, length, "r");
+  double start = bench_seconds();
+  int errors = show_compile(in, "synthetic", &image, &size);
+  double compileSeconds = bench_seconds() - start;
+  fclose(in);
+  free(text);
+  if (errors > 0)
+  {
+    fprintf(stderr, "synthetic show with %d cues did not compile\n", cues);
+    exit(1);
+  }
+
+  snprintf(path, sizeof(path), "/tmp/show_bench_%d.show", (int)getpid());
+  if (show_write(path, image, size) != 0)
+  {
+    fprintf(stderr, "could not write %s\n", path);
+    exit(1);
+  }
+  free(image);
+
+  snprintf(name, sizeof(name), "show_%d_compile", cues);
+  bench_report(name, compileSeconds * 1000, "ms");
+  snprintf(name, sizeof(name), "show_%d_bytes", cues);
+  bench_report_count(name, size, "bytes");
+
+  start = bench_seconds();
+  for (i = 0; i < LOADS; i++)
+  {
+    if (show_load(&shows[0], path) != 0)
+      load_failed(path);
+    show_unload(&shows[0]);
+  }
+  snprintf(name, sizeof(name), "show_%d_load", cues);
+  bench_report(name, (bench_seconds() - start) * 1e6 / LOADS, "us");
+
+  if (show_load(&shows[0], path) != 0)
+    load_failed(path);
+  snprintf(name, sizeof(name), "show_%d_resident_after_load", cues);
+  bench_report_count(name, mapping_resident_kb(shows[0].base), "kB");
+
+  // what a show run touches: every cue, its still path and curve
+  float total = 0;
+  for (i = 0; i < show_cue_count(&shows[0]); i++)
+  {
+    const SHOW_CUE_T *cue = show_cue(&shows[0], i);
+    total += cue->alpha + show_string(&shows[0], cue->still)[0] +
+             show_curve_value(&shows[0], show_curve(&shows[0], cue->curve), 0.5f);
+  }
+  sink = total;
+  snprintf(name, sizeof(name), "show_%d_resident_after_cues", cues);
+  bench_report_count(name, mapping_resident_kb(shows[0].base), "kB");
+
+  // the player's SIGHUP path: load into the spare slot, then drop the old one
+  SHOW_T *current = &shows[0], *spare = &shows[1];
+  start = bench_seconds();
+  for (i = 0; i < LOADS; i++)
+  {
+    SHOW_T *swap = current;
+    if (show_load(spare, path) != 0)
+      load_failed(path);
+    sink = show_cue(spare, show_cue_count(spare) - 1)->alpha;
+    show_unload(current);
+    current = spare;
+    spare = swap;
+  }
+  snprintf(name, sizeof(name), "show_%d_reload", cues);
+  bench_report(name, (bench_seconds() - start) * 1e6 / LOADS, "us");
+
+  show_unload(current);
+  unlink(path);
+}
+
+// A sparse 2GB file standing in for a video on the command line.
+static void bench_not_show(void)
+{
+  char path[256];
+  SHOW_T show;
+  int i, wrong = 0;
+
+  snprintf(path, sizeof(path), "/tmp/show_bench_%d.h264", (int)getpid());
+  FILE *out = fopen(path, "wb");
+  if (out == NULL)
+    return;
+  fclose(out);
+  if (truncate(path, 2048LL * 1024 * 1024) != 0)
+  {
+    unlink(path);
+    return;
+  }
+
+  double start = bench_seconds();
+  for (i = 0; i < LOADS; i++)
+  {
+    if (show_load(&show, path) != SHOW_ERROR_NOT_SHOW)
+    {
+      show_unload(&show);
+      wrong++;
+    }
+  }
+  double elapsed = bench_seconds() - start;
+  unlink(path);
+  if (wrong > 0)
+  {
+    fprintf(stderr, "video was not turned away as a show\n");
+    exit(1);
+  }
+  bench_report("show_not_show_load", elapsed * 1e6 / LOADS, "us");
+}
+
+int main(int argc, char **argv)
+{
+  bench_not_show();
+  bench_show(100);
+  bench_show(1000);
+  bench_show(10000);
+  return 0;
+}
@@ -0,0 +1,219 @@
+// Headless benchmark for the still image layer: decode throughput against
+// worker count, and texture cache hit rate for a cue sequence with
+// predictive preloading. Test images are generated into a temporary
+// directory so no fixtures are needed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include "bench.h"
+#include "stills.h"
+
+#define JPEG_COUNT 12
+#define PNG_COUNT 4
+#define IMAGE_COUNT (JPEG_COUNT + PNG_COUNT)
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+// frames the operator waits between cues in the simulated show
+#define FRAMES_PER_CUE 12
+
+static char dir[] = "/tmp/stills_benchXXXXXX";
+static char paths[IMAGE_COUNT][IMAGE_PATH_MAX];
+static char *cues[IMAGE_COUNT];
+
+static void fill_pattern(unsigned char *row, int y, int width, int components, int seed)
+{
+  int x;
+  for (x = 0; x < width; x++)
+  {
+    unsigned int noise = (x * 7919u + y * 104729u + seed * 31u) * 2654435761u;
+    row[x * components + 0] = (x + seed * 16) & 0xFF;
+    row[x * components + 1] = (y + (noise >> 28)) & 0xFF;
+    row[x * components + 2] = (x ^ y) & 0xFF;
+    if (components == 4)
+      row[x * components + 3] = 255;
+  }
+}
+
+static void write_jpeg(const char *path, int width, int height, int seed)
+{
+  struct jpeg_compress_struct cinfo;
+  struct jpeg_error_mgr jerr;
+  unsigned char *row = malloc(width * 3);
+  FILE *out = fopen(path, "wb");
+
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  jpeg_stdio_dest(&cinfo, out);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, 85, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height)
+  {
+    fill_pattern(row, cinfo.next_scanline, width, 3, seed);
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  fclose(out);
+  free(row);
+}
+
+static void write_png(const char *path, int width, int height, int seed)
+{
+  png_image png;
+  unsigned char *rgba = malloc((size_t)width * height * 4);
+  int y;
+
+  for (y = 0; y < height; y++)
+    fill_pattern(rgba + (size_t)y * width * 4, y, width, 4, seed);
+
+  memset(&png, 0, sizeof(png));
+  png.version = PNG_IMAGE_VERSION;
+  png.width = width;
+  png.height = height;
+  png.format = PNG_FORMAT_RGBA;
+  png_image_write_to_file(&png, path, 0, rgba, 0, NULL);
+  free(rgba);
+}
+
+static unsigned int fake_upload(void *userdata, const IMAGE_T *image)
+{
+  static unsigned int next = 1;
+  return next++;
+}
+
+static void fake_release(void *userdata, unsigned int tex)
+{
+}
+
+static void bench_decode(int workers)
+{
+  IMAGE_LOADER_T loader;
+  IMAGE_T *image;
+  int i, received = 0;
+  char name[64];
+
+  workers = image_loader_init(&loader, workers, SCREEN_WIDTH, SCREEN_HEIGHT);
+  double start = bench_seconds();
+  for (i = 0; i < IMAGE_COUNT; i++)
+    image_loader_request(&loader, paths[i]);
+  while (received < IMAGE_COUNT)
+  {
+    if ((image = image_loader_poll(&loader)) != NULL)
+    {
+      received++;
+      image_free(image);
+    }
+    else
+      usleep(1000);
+  }
+  double elapsed = bench_seconds() - start;
+  image_loader_destroy(&loader);
+
+  snprintf(name, sizeof(name), "stills_decode_workers_%d", workers);
+  bench_report(name, IMAGE_COUNT / elapsed, "images/s");
+}
+
+// Runs through the cues forwards, with a few steps back as happens when a
+// cue is re-run, counting how often an image is already uploaded on its cue.
+// The budget is in screen-sized images; prefix names the results.
+static void bench_cache(const char *prefix, int budgetImages)
+{
+  char name[64];
+  STILLS_T stills;
+  IMAGE_CACHE_STATS_T stats;
+  int sequence[IMAGE_COUNT + 4];
+  int i, frame, length = 0;
+  double waited = 0;
+
+  for (i = 0; i < IMAGE_COUNT; i++)
+  {
+    sequence[length++] = i;
+    if (i == IMAGE_COUNT / 2)
+    {
+      sequence[length++] = i - 2;
+      sequence[length++] = i - 1;
+      sequence[length++] = i;
+    }
+  }
+
+  stills_init(&stills, cues, IMAGE_COUNT, 0, SCREEN_WIDTH, SCREEN_HEIGHT,
+              (size_t)budgetImages * SCREEN_WIDTH * SCREEN_HEIGHT * 4, fake_upload, fake_release, NULL);
+
+  for (i = 0; i < length; i++)
+  {
+    stills_go(&stills, sequence[i]);
+    double start = bench_seconds();
+    while (stills_showing(&stills) == NULL ||
+           strcmp(stills_showing(&stills)->path, cues[sequence[i]]) != 0)
+    {
+      usleep(1000);
+      stills_update(&stills);
+    }
+    waited += bench_seconds() - start;
+
+    for (frame = 0; frame < FRAMES_PER_CUE; frame++)
+    {
+      usleep(16000);
+      stills_update(&stills);
+    }
+  }
+
+  image_cache_get_stats(&stills.cache, &stats);
+  unsigned long uploads = stills.uploads;
+  stills_destroy(&stills);
+
+  snprintf(name, sizeof(name), "%s_hit_rate", prefix);
+  bench_report(name, 100.0 * stats.hits / (stats.hits + stats.misses), "%");
+  snprintf(name, sizeof(name), "%s_cue_wait", prefix);
+  bench_report(name, 1000.0 * waited / length, "ms");
+  // more uploads than images means something was evicted and decoded again
+  snprintf(name, sizeof(name), "%s_uploads", prefix);
+  bench_report_count(name, uploads, "images");
+}
+
+int main(int argc, char **argv)
+{
+  int i, workers, cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (mkdtemp(dir) == NULL)
+  {
+    perror("mkdtemp");
+    return 1;
+  }
+  for (i = 0; i < IMAGE_COUNT; i++)
+  {
+    cues[i] = paths[i];
+    if (i < JPEG_COUNT)
+    {
+      snprintf(paths[i], IMAGE_PATH_MAX, "%s/%02d.jpg", dir, i);
+      write_jpeg(paths[i], 3840, 2160, i);
+    }
+    else
+    {
+      snprintf(paths[i], IMAGE_PATH_MAX, "%s/%02d.png", dir, i);
+      write_png(paths[i], SCREEN_WIDTH, SCREEN_HEIGHT, i);
+    }
+  }
+
+  for (workers = 1; workers <= cores && workers <= IMAGE_LOADER_MAX_WORKERS; workers *= 2)
+    bench_decode(workers);
+  bench_cache("stills_cache", 5);
+  // only room for the current cue and the preload window
+  bench_cache("stills_cache_tight", STILLS_PRELOAD_AHEAD + 1);
+
+  for (i = 0; i < IMAGE_COUNT; i++)
+    unlink(paths[i]);
+  rmdir(dir);
+  return 0;
+}
@@ -0,0 +1,435 @@
+// Deterministic stand-in for the OMX decode pipeline, see stub_omx.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "stubs/ilclient.h"
+#include "stub_omx.h"
+
+#define STUB_MAX_COMPONENTS 8
+#define STUB_MAX_OUTPUT_BUFFERS 32
+// input buffers still accepted after the output stalls
+#define STUB_OUTPUT_STALL_BACKLOG 4
+// decoded pictures held while egl_render has no buffer, as the decoder would
+#define STUB_MAX_PENDING 64
+
+struct _COMPONENT_T
+{
+  char name[32];
+};
+
+struct _ILCLIENT_T
+{
+  ILCLIENT_BUFFER_CALLBACK_T fillDone;
+  void *fillDoneData;
+};
+
+STUB_OMX_CONFIG_T stub_omx_config = { 81920, 1, 0, NULL, 0, STUB_FAULT_NONE, 0 };
+STUB_OMX_STATS_T stub_omx_stats;
+
+static ILCLIENT_T client;
+static COMPONENT_T components[STUB_MAX_COMPONENTS];
+static int componentCount;
+static COMPONENT_T *eglRender;
+
+static OMX_BUFFERHEADERTYPE input;
+static unsigned char *inputData;
+
+static OMX_BUFFERHEADERTYPE outputs[STUB_MAX_OUTPUT_BUFFERS];
+static int outputCount;
+// handed over by OMX_FillThisBuffer, waiting to be "decoded" into
+static OMX_BUFFERHEADERTYPE *filling;
+// decoded, waiting for ilclient_get_output_buffer
+static OMX_BUFFERHEADERTYPE *filled;
+static int portSettingsSent;
+static long bufferPictures[STUB_MAX_OUTPUT_BUFFERS];
+static int bufferPipelines[STUB_MAX_OUTPUT_BUFFERS];
+static long pending[STUB_MAX_PENDING];
+static int pendingCount;
+
+// fault in effect for the current pipeline
+static int faulted;
+static unsigned long faultedAt;
+// where a hung teardown waits, never signalled
+static pthread_mutex_t hangLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t hang = PTHREAD_COND_INITIALIZER;
+
+// synthetic stream parser, restarted with each pipeline
+static int zeros;
+static int nalType;
+static int nalBytes;
+static long picture;
+
+static double monotonic_seconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_nsec / 1000000000 + (double)t.tv_sec;
+}
+
+static void reset_pipeline(void)
+{
+  componentCount = 0;
+  eglRender = NULL;
+  outputCount = 0;
+  filling = NULL;
+  filled = NULL;
+  portSettingsSent = 0;
+  faulted = STUB_FAULT_NONE;
+  pendingCount = 0;
+  zeros = 0;
+  nalType = -1;
+  nalBytes = 0;
+}
+
+void stub_omx_reset(void)
+{
+  memset(&stub_omx_stats, 0, sizeof(stub_omx_stats));
+  stub_omx_stats.checksum = 2166136261u;
+  memset(bufferPictures, 0, sizeof(bufferPictures));
+  memset(bufferPipelines, 0, sizeof(bufferPipelines));
+  reset_pipeline();
+}
+
+static void put_start_code(FILE *out, int header)
+{
+  fputc(0, out);
+  fputc(0, out);
+  fputc(1, out);
+  fputc(header, out);
+}
+
+/***********************************************************
+ * Name: stub_omx_write_stream
+ *
+ * Arguments:
+ *       const char *path - file to write
+ *       long pictures - number of pictures
+ *       int gop - pictures from one SPS to the next
+ *       int pictureBytes - size of each picture's slice
+ *
+ * Description:   Writes something shaped like an H.264 elementary stream:
+ *                an SPS and PPS before every IDR, then one slice per
+ *                picture with first_mb_in_slice 0. Each slice carries its
+ *                picture number, seven bits to a byte with the top bit
+ *                set so it can never look like a start code.
+ *
+ * Returns: int - 0 on success
+ *
+ ***********************************************************/
+int stub_omx_write_stream(const char *path, long pictures, int gop, int pictureBytes)
+{
+  FILE *out = fopen(path, "wb");
+  long n;
+  int i;
+
+  if (out == NULL)
+    return -1;
+  for (n = 0; n < pictures; n++)
+  {
+    if (n % gop == 0)
+    {
+      put_start_code(out, 0x67);
+      for (i = 0; i < 8; i++)
+        fputc(0x42, out);
+      put_start_code(out, 0x68);
+      for (i = 0; i < 4; i++)
+        fputc(0xce, out);
+    }
+    put_start_code(out, n % gop == 0 ? 0x65 : 0x41);
+    fputc(0x88, out);
+    for (i = 3; i >= 0; i--)
+      fputc(0x80 | ((n >> (7 * i)) & 0x7f), out);
+    for (i = 9; i < pictureBytes; i++)
+      fputc(0x55, out);
+  }
+  return fclose(out);
+}
+
+// Picture last decoded into output buffer index, which is also the frame
+// cache slot, and the pipeline that decoded it.
+long stub_omx_buffer_picture(int index, int *pipeline)
+{
+  if (index < 0 || index >= STUB_MAX_OUTPUT_BUFFERS)
+    return -1;
+  if (pipeline != NULL)
+    *pipeline = bufferPipelines[index];
+  return bufferPictures[index];
+}
+
+OMX_HANDLETYPE ilclient_get_handle(COMPONENT_T *comp)
+{
+  return comp;
+}
+
+// A pipeline abandoned in a hung teardown was never destroyed, so a new
+// client starts from a clean pipeline either way.
+ILCLIENT_T *ilclient_init(void)
+{
+  memset(&client, 0, sizeof(client));
+  reset_pipeline();
+  return &client;
+}
+
+void ilclient_destroy(ILCLIENT_T *c)
+{
+  free(inputData);
+  inputData = NULL;
+  reset_pipeline();
+}
+
+void ilclient_set_fill_buffer_done_callback(ILCLIENT_T *c, ILCLIENT_BUFFER_CALLBACK_T func, void *userdata)
+{
+  c->fillDone = func;
+  c->fillDoneData = userdata;
+}
+
+int ilclient_create_component(ILCLIENT_T *c, COMPONENT_T **comp, char *name, int flags)
+{
+  if (componentCount == STUB_MAX_COMPONENTS)
+    return -1;
+  *comp = &components[componentCount++];
+  snprintf((*comp)->name, sizeof((*comp)->name), "%s", name);
+  if (strcmp(name, "egl_render") == 0)
+    eglRender = *comp;
+  return 0;
+}
+
+void ilclient_cleanup_components(COMPONENT_T *list[])
+{
+}
+
+int ilclient_change_component_state(COMPONENT_T *comp, int state)
+{
+  return 0;
+}
+
+void ilclient_state_transition(COMPONENT_T *list[], int state)
+{
+  if (faulted != STUB_FAULT_TEARDOWN_HANG)
+    return;
+  pthread_mutex_lock(&hangLock);
+  stub_omx_stats.teardownsHung++;
+  for (;;)
+    pthread_cond_wait(&hang, &hangLock);
+}
+
+void set_tunnel(TUNNEL_T *tunnel, COMPONENT_T *source, int source_port, COMPONENT_T *sink, int sink_port)
+{
+  tunnel->source = source;
+  tunnel->source_port = source_port;
+  tunnel->sink = sink;
+  tunnel->sink_port = sink_port;
+}
+
+int ilclient_setup_tunnel(TUNNEL_T *tunnel, unsigned int portStream, int timeout)
+{
+  return 0;
+}
+
+void ilclient_disable_tunnel(TUNNEL_T *tunnel)
+{
+}
+
+void ilclient_teardown_tunnels(TUNNEL_T *tunnels)
+{
+}
+
+void ilclient_flush_tunnels(TUNNEL_T *tunnel, int max)
+{
+}
+
+int ilclient_enable_port_buffers(COMPONENT_T *comp, int portIndex, void *allocator, void *free_func, void *userdata)
+{
+  stub_omx_stats.pipelines++;
+  free(inputData);
+  inputData = malloc(stub_omx_config.inputBufferSize);
+  memset(&input, 0, sizeof(input));
+  input.pBuffer = inputData;
+  input.nAllocLen = stub_omx_config.inputBufferSize;
+  input.nInputPortIndex = portIndex;
+  return inputData != NULL ? 0 : -1;
+}
+
+void ilclient_disable_port_buffers(COMPONENT_T *comp, int portIndex, OMX_BUFFERHEADERTYPE *buffers, void *free_func, void *userdata)
+{
+}
+
+OMX_BUFFERHEADERTYPE *ilclient_get_input_buffer(COMPONENT_T *comp, int portIndex, int block)
+{
+  // a wedged decoder never hands the buffer back, blocking or not
+  if (faulted == STUB_FAULT_INPUT_STALL || faulted == STUB_FAULT_TEARDOWN_HANG ||
+      (faulted == STUB_FAULT_OUTPUT_STALL && stub_omx_stats.buffersEmptied >= faultedAt + STUB_OUTPUT_STALL_BACKLOG))
+    return NULL;
+  if (stub_omx_config.onInput != NULL)
+    stub_omx_config.onInput(stub_omx_stats.buffersEmptied);
+  return &input;
+}
+
+OMX_BUFFERHEADERTYPE *ilclient_get_output_buffer(COMPONENT_T *comp, int portIndex, int block)
+{
+  OMX_BUFFERHEADERTYPE *buffer = filled;
+  filled = NULL;
+  return buffer;
+}
+
+// The real decoder reports the output format once it has seen the first
+// buffer of the stream.
+int ilclient_remove_event(COMPONENT_T *comp, int event, OMX_U32 nData1, int ignore1, OMX_U32 nData2, int ignore2)
+{
+  if (event == OMX_EventPortSettingsChanged && stub_omx_stats.buffersEmptied > 0 && !portSettingsSent)
+  {
+    portSettingsSent = 1;
+    return 0;
+  }
+  return -1;
+}
+
+int ilclient_wait_for_event(COMPONENT_T *comp, int event, OMX_U32 nData1, int ignore1, OMX_U32 nData2, int ignore2, int event_flag, int suspend)
+{
+  return ilclient_remove_event(comp, event, nData1, ignore1, nData2, ignore2);
+}
+
+OMX_ERRORTYPE OMX_Init(void)
+{
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_Deinit(void)
+{
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_GetParameter(OMX_HANDLETYPE handle, int index, OMX_PTR param)
+{
+  if (index == OMX_IndexParamPortDefinition)
+  {
+    OMX_PARAM_PORTDEFINITIONTYPE *portdef = param;
+    portdef->nBufferCountActual = 1;
+    portdef->nBufferCountMin = 1;
+  }
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_SetParameter(OMX_HANDLETYPE handle, int index, OMX_PTR param)
+{
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_SendCommand(OMX_HANDLETYPE handle, int cmd, OMX_U32 param, OMX_PTR data)
+{
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_UseEGLImage(OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE **buffer, OMX_U32 port, OMX_PTR priv, void *eglImage)
+{
+  if (outputCount == STUB_MAX_OUTPUT_BUFFERS)
+    return OMX_ErrorUndefined;
+  *buffer = &outputs[outputCount++];
+  memset(*buffer, 0, sizeof(**buffer));
+  (*buffer)->nOutputPortIndex = port;
+  (*buffer)->pAppPrivate = priv;
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_FillThisBuffer(OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE *buffer)
+{
+  if (buffer == NULL || filling != NULL || faulted == STUB_FAULT_FILL_ERROR)
+    return OMX_ErrorUndefined;
+  filling = buffer;
+  return OMX_ErrorNone;
+}
+
+static void decoded(long number)
+{
+  if (pendingCount < STUB_MAX_PENDING)
+    pending[pendingCount++] = number;
+}
+
+// Hands decoded pictures to egl_render while it has a buffer to fill. The
+// callback gives it the next one.
+static void deliver_frames(void)
+{
+  while (pendingCount > 0 && filling != NULL && faulted != STUB_FAULT_OUTPUT_STALL)
+  {
+    if (stub_omx_config.frameMicros > 0)
+      usleep(stub_omx_config.frameMicros);
+    bufferPictures[filling - outputs] = pending[0];
+    bufferPipelines[filling - outputs] = stub_omx_stats.pipelines;
+    memmove(pending, pending + 1, --pendingCount * sizeof(pending[0]));
+    filled = filling;
+    filling = NULL;
+    stub_omx_stats.framesFilled++;
+    if (client.fillDone != NULL)
+      client.fillDone(client.fillDoneData, eglRender);
+  }
+}
+
+// Follows the synthetic stream a byte at a time, delivering a frame as
+// soon as a slice's picture number has been read.
+static void decode_pictures(const unsigned char *data, OMX_U32 len)
+{
+  OMX_U32 i;
+
+  for (i = 0; i < len; i++)
+  {
+    unsigned char b = data[i];
+
+    if (nalType == 1 || nalType == 5)
+    {
+      if (++nalBytes >= 2)
+        picture = (picture << 7) | (b & 0x7f);
+      if (nalBytes == 5)
+      {
+        decoded(picture);
+        nalType = -1;
+      }
+    }
+    else if (nalType == 0)
+    {
+      nalType = b & 0x1f;
+      nalBytes = 0;
+      picture = 0;
+    }
+
+    if (b == 1 && zeros >= 2)
+      nalType = 0;
+    zeros = b == 0 ? zeros + 1 : 0;
+  }
+}
+
+OMX_ERRORTYPE OMX_EmptyThisBuffer(OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE *buffer)
+{
+  OMX_U32 i;
+
+  if (stub_omx_config.fault != STUB_FAULT_NONE && stub_omx_stats.faultsInjected == 0 &&
+      stub_omx_stats.buffersEmptied >= stub_omx_config.faultAfterBuffers)
+  {
+    faulted = stub_omx_config.fault;
+    faultedAt = stub_omx_stats.buffersEmptied;
+    stub_omx_stats.faultsInjected++;
+    stub_omx_stats.faultSeconds = monotonic_seconds();
+  }
+  if (faulted == STUB_FAULT_EMPTY_ERROR)
+    return OMX_ErrorUndefined;
+
+  if (buffer->nFilledLen == 0)
+    return OMX_ErrorNone;
+
+  // FNV-1a over everything fed, so a replay can tell if it read the same data
+  for (i = 0; i < buffer->nFilledLen; i++)
+    stub_omx_stats.checksum = (stub_omx_stats.checksum ^ buffer->pBuffer[buffer->nOffset + i]) * 16777619u;
+  stub_omx_stats.bytes += buffer->nFilledLen;
+  stub_omx_stats.buffersEmptied++;
+
+  if (stub_omx_config.pictureFrames)
+    decode_pictures(buffer->pBuffer + buffer->nOffset, buffer->nFilledLen);
+  else if (stub_omx_stats.buffersEmptied % stub_omx_config.buffersPerFrame == 0)
+    decoded(stub_omx_stats.buffersEmptied / stub_omx_config.buffersPerFrame - 1);
+  deliver_frames();
+  return OMX_ErrorNone;
+}
@@ -0,0 +1,63 @@
+// Deterministic stand-in for the OMX decode pipeline used by the replay
+// harness. Input buffers are consumed synchronously and egl_render
+// "decodes" a frame every few buffers by calling the fill callback from
+// inside OMX_EmptyThisBuffer, so a run never depends on thread timing.
+//
+// With pictureFrames set it decodes the synthetic stream written by
+// stub_omx_write_stream() instead: a frame per picture, tagged with the
+// picture number, so a test can see exactly which picture is on screen.
+// A fault can be injected once after a given number of buffers and lasts
+// until the pipeline is torn down, or for a teardown hang, until the next
+// ilclient_init.
+#pragma once
+
+#include <stdint.h>
+
+#define STUB_FAULT_NONE 0
+// the decoder stops taking input buffers
+#define STUB_FAULT_INPUT_STALL 1
+// no more frames come out and input backs up soon after
+#define STUB_FAULT_OUTPUT_STALL 2
+// OMX_EmptyThisBuffer returns an error
+#define STUB_FAULT_EMPTY_ERROR 3
+// OMX_FillThisBuffer returns an error
+#define STUB_FAULT_FILL_ERROR 4
+// the decoder stops taking input buffers and the pipeline never finishes
+// its state change when torn down
+#define STUB_FAULT_TEARDOWN_HANG 5
+
+typedef struct
+{
+  int inputBufferSize;
+  // input buffers consumed for each frame delivered to egl_render
+  int buffersPerFrame;
+  // sleep per delivered frame, 0 to run flat out
+  int frameMicros;
+  // called by ilclient_get_input_buffer with the buffers emptied so far
+  void (*onInput)(int buffersFed);
+  int pictureFrames;
+  int fault;
+  unsigned long faultAfterBuffers;
+} STUB_OMX_CONFIG_T;
+
+typedef struct
+{
+  unsigned long buffersEmptied;
+  unsigned long long bytes;
+  uint32_t checksum;
+  unsigned long framesFilled;
+  int faultsInjected;
+  // CLOCK_MONOTONIC seconds when the fault was injected
+  double faultSeconds;
+  // pipelines built, more than one after a restart
+  int pipelines;
+  // teardowns stuck in the hang fault, which never return
+  int teardownsHung;
+} STUB_OMX_STATS_T;
+
+extern STUB_OMX_CONFIG_T stub_omx_config;
+extern STUB_OMX_STATS_T stub_omx_stats;
+
+void stub_omx_reset(void);
+int stub_omx_write_stream(const char *path, long pictures, int gop, int pictureBytes);
+long stub_omx_buffer_picture(int index, int *pipeline);
@@ -0,0 +1,3 @@
+// Stand-in for the Broadcom host header when building the decoder for
+// headless replay. video.c does not use anything from it directly.
+#pragma once
@@ -0,0 +1,135 @@
+// Stand-in for ilclient.h and the OpenMAX IL headers, declaring only what
+// video.c uses. The functions are implemented by bench/stub_omx.c.
+#pragma once
+
+#include <stdint.h>
+
+typedef int OMX_ERRORTYPE;
+typedef void *OMX_HANDLETYPE;
+typedef void *OMX_PTR;
+typedef uint32_t OMX_U32;
+typedef int64_t OMX_TICKS;
+
+#define OMX_ErrorNone 0
+#define OMX_ErrorUndefined 0x80001001
+#define OMX_VERSION 0x00000101
+
+typedef union
+{
+  OMX_U32 nVersion;
+} OMX_VERSIONTYPE;
+
+typedef struct
+{
+  OMX_U32 nSize;
+  OMX_VERSIONTYPE nVersion;
+  unsigned char *pBuffer;
+  OMX_U32 nAllocLen;
+  OMX_U32 nFilledLen;
+  OMX_U32 nOffset;
+  OMX_PTR pAppPrivate;
+  OMX_TICKS nTimeStamp;
+  OMX_U32 nFlags;
+  OMX_U32 nOutputPortIndex;
+  OMX_U32 nInputPortIndex;
+} OMX_BUFFERHEADERTYPE;
+
+typedef struct
+{
+  OMX_U32 nSize;
+  OMX_VERSIONTYPE nVersion;
+  int eState;
+  OMX_TICKS nStartTime;
+  OMX_TICKS nOffset;
+  OMX_U32 nWaitMask;
+} OMX_TIME_CONFIG_CLOCKSTATETYPE;
+
+typedef struct
+{
+  OMX_U32 nSize;
+  OMX_VERSIONTYPE nVersion;
+  OMX_U32 nPortIndex;
+  OMX_U32 nIndex;
+  int eCompressionFormat;
+  int eColorFormat;
+  OMX_U32 xFramerate;
+} OMX_VIDEO_PARAM_PORTFORMATTYPE;
+
+typedef struct
+{
+  OMX_U32 nSize;
+  OMX_VERSIONTYPE nVersion;
+  OMX_U32 nPortIndex;
+  int eDir;
+  OMX_U32 nBufferCountActual;
+  OMX_U32 nBufferCountMin;
+  OMX_U32 nBufferSize;
+} OMX_PARAM_PORTDEFINITIONTYPE;
+
+#define OMX_TIME_ClockStateWaitingForStartTime 1
+#define OMX_VIDEO_CodingAVC 7
+
+#define OMX_IndexParamPortDefinition 0x02000001
+#define OMX_IndexParamVideoPortFormat 0x06000001
+#define OMX_IndexConfigTimeClockState 0x09000002
+
+#define OMX_StateLoaded 1
+#define OMX_StateIdle 2
+#define OMX_StateExecuting 3
+
+#define OMX_EventPortSettingsChanged 3
+#define OMX_CommandPortEnable 3
+
+#define OMX_BUFFERFLAG_EOS 0x00000001
+#define OMX_BUFFERFLAG_STARTTIME 0x00000002
+#define OMX_BUFFERFLAG_TIME_UNKNOWN 0x00000100
+
+#define ILCLIENT_DISABLE_ALL_PORTS 0x4
+#define ILCLIENT_ENABLE_INPUT_BUFFERS 0x10
+#define ILCLIENT_ENABLE_OUTPUT_BUFFERS 0x20
+#define ILCLIENT_EVENT_ERROR 0x4
+#define ILCLIENT_PARAMETER_CHANGED 0x8
+
+typedef struct _COMPONENT_T COMPONENT_T;
+typedef struct _ILCLIENT_T ILCLIENT_T;
+
+typedef struct
+{
+  COMPONENT_T *source;
+  int source_port;
+  COMPONENT_T *sink;
+  int sink_port;
+} TUNNEL_T;
+
+typedef void (*ILCLIENT_BUFFER_CALLBACK_T)(void *userdata, COMPONENT_T *comp);
+
+#define ILC_GET_HANDLE(x) ilclient_get_handle(x)
+
+OMX_HANDLETYPE ilclient_get_handle(COMPONENT_T *comp);
+ILCLIENT_T *ilclient_init(void);
+void ilclient_destroy(ILCLIENT_T *client);
+void ilclient_set_fill_buffer_done_callback(ILCLIENT_T *client, ILCLIENT_BUFFER_CALLBACK_T func, void *userdata);
+int ilclient_create_component(ILCLIENT_T *client, COMPONENT_T **comp, char *name, int flags);
+void ilclient_cleanup_components(COMPONENT_T *list[]);
+int ilclient_change_component_state(COMPONENT_T *comp, int state);
+void ilclient_state_transition(COMPONENT_T *list[], int state);
+void set_tunnel(TUNNEL_T *tunnel, COMPONENT_T *source, int source_port, COMPONENT_T *sink, int sink_port);
+int ilclient_setup_tunnel(TUNNEL_T *tunnel, unsigned int portStream, int timeout);
+void ilclient_disable_tunnel(TUNNEL_T *tunnel);
+void ilclient_teardown_tunnels(TUNNEL_T *tunnels);
+void ilclient_flush_tunnels(TUNNEL_T *tunnel, int max);
+int ilclient_enable_port_buffers(COMPONENT_T *comp, int portIndex, void *allocator, void *free, void *userdata);
+void ilclient_disable_port_buffers(COMPONENT_T *comp, int portIndex, OMX_BUFFERHEADERTYPE *buffers, void *free, void *userdata);
+OMX_BUFFERHEADERTYPE *ilclient_get_input_buffer(COMPONENT_T *comp, int portIndex, int block);
+OMX_BUFFERHEADERTYPE *ilclient_get_output_buffer(COMPONENT_T *comp, int portIndex, int block);
+int ilclient_remove_event(COMPONENT_T *comp, int event, OMX_U32 nData1, int ignore1, OMX_U32 nData2, int ignore2);
+int ilclient_wait_for_event(COMPONENT_T *comp, int event, OMX_U32 nData1, int ignore1, OMX_U32 nData2, int ignore2, int event_flag, int suspend);
+
+OMX_ERRORTYPE OMX_Init(void);
+OMX_ERRORTYPE OMX_Deinit(void);
+OMX_ERRORTYPE OMX_GetParameter(OMX_HANDLETYPE handle, int index, OMX_PTR param);
+OMX_ERRORTYPE OMX_SetParameter(OMX_HANDLETYPE handle, int index, OMX_PTR param);
+OMX_ERRORTYPE OMX_SendCommand(OMX_HANDLETYPE handle, int cmd, OMX_U32 param, OMX_PTR data);
+OMX_ERRORTYPE OMX_UseEGLImage(OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE **buffer, OMX_U32 port, OMX_PTR priv, void *eglImage);
+OMX_ERRORTYPE OMX_EmptyThisBuffer(OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE *buffer);
+OMX_ERRORTYPE OMX_FillThisBuffer(OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE *buffer);
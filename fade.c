@@ -0,0 +1,49 @@
+// Alpha fades, see fade.h
+
+#include <stdio.h>
+
+#include "fade.h"
+
+void fade_start(FADE_DATA_T *fade, float target, float speed, float alpha, double now)
+{
+  fade->target = target;
+  fade->speed = speed;
+  fade->startSeconds = now;
+  fade->startAlpha = alpha;
+}
+
+/***********************************************************
+ * Name: fade_update
+ *
+ * Arguments:
+ *       FADE_DATA_T *fade - fade in progress
+ *       float alpha - current alpha
+ *       double now - current time in seconds
+ *
+ * Description:   Moves alpha towards the fade target at the fade speed.
+ *                A finished fade sets its speed negative.
+ *
+ * Returns: float - new alpha
+ *
+ ***********************************************************/
+float fade_update(FADE_DATA_T *fade, float alpha, double now)
+{
+  if (fade == NULL || fade->speed < 0)
+    return alpha;
+  // dir > 1 iff alpha is increasing
+  int dir = 1;
+  if (fade->target < fade->startAlpha)
+    dir = -1;
+
+  double timeDiff = now - fade->startSeconds;
+  // delta = magnitude of change since start
+  float delta = timeDiff * fade->speed;
+  // alpha = alpha' * delta * dir
+  alpha = fade->startAlpha + (delta * dir);
+  if ((dir > 0 && alpha > fade->target) || (dir < 0 && alpha < fade->target)) {
+    printf("Finished fade to %f\n", fade->target);
+    fade->speed = -1;
+    return fade->target;
+  }
+  return alpha;
+}
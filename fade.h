@@ -0,0 +1,8 @@
+// Alpha fades, kept apart from the renderer so they can be replayed
+// against a recorded clock.
+#pragma once
+
+#include "triangle.h"
+
+void fade_start(FADE_DATA_T *fade, float target, float speed, float alpha, double now);
+float fade_update(FADE_DATA_T *fade, float alpha, double now);
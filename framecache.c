@@ -0,0 +1,305 @@
+// Bounded cache of recently decoded video frames, see framecache.h
+
+#include <string.h>
+
+#include "framecache.h"
+
+#define DEFAULT_FRAME_PERIOD (1.0 / 25.0)
+
+static int is_reusable(FRAME_CACHE_T *cache, int slot);
+
+/***********************************************************
+ * Name: frame_cache_init
+ *
+ * Arguments:
+ *       FRAME_CACHE_T *cache - cache to initialise
+ *       size_t frameBytes - GPU memory used by one decoded frame
+ *       size_t budgetBytes - GPU memory the whole cache may use
+ *       double windowSeconds - age after which a frame is evicted
+ *                              ahead of the LRU order
+ *
+ * Description: Clears the cache and works out how many slots fit in
+ *              the budget. At least two slots are allowed so one frame
+ *              can stay on screen while the next is decoded.
+ *
+ * Returns: int - number of slots the caller should add
+ *
+ ***********************************************************/
+int frame_cache_init(FRAME_CACHE_T *cache, size_t frameBytes, size_t budgetBytes, double windowSeconds)
+{
+  memset(cache, 0, sizeof(*cache));
+  pthread_mutex_init(&cache->lock, NULL);
+
+  cache->frameBytes = frameBytes;
+  cache->windowSeconds = windowSeconds;
+  cache->pinned = -1;
+
+  cache->capacity = frameBytes > 0 ? budgetBytes / frameBytes : FRAME_CACHE_MAX_SLOTS;
+  if (cache->capacity < 2)
+    cache->capacity = 2;
+  if (cache->capacity > FRAME_CACHE_MAX_SLOTS)
+    cache->capacity = FRAME_CACHE_MAX_SLOTS;
+  return cache->capacity;
+}
+
+void frame_cache_destroy(FRAME_CACHE_T *cache)
+{
+  pthread_mutex_destroy(&cache->lock);
+  cache->count = 0;
+}
+
+int frame_cache_add_slot(FRAME_CACHE_T *cache, unsigned int tex, void *eglImage)
+{
+  int slot = -1;
+
+  pthread_mutex_lock(&cache->lock);
+  if (cache->count < cache->capacity)
+  {
+    slot = cache->count++;
+    memset(&cache->slots[slot], 0, sizeof(cache->slots[slot]));
+    cache->slots[slot].tex = tex;
+    cache->slots[slot].eglImage = eglImage;
+    cache->slots[slot].frame = -1;
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return slot;
+}
+
+void frame_cache_attach_buffer(FRAME_CACHE_T *cache, int slot, void *buffer)
+{
+  pthread_mutex_lock(&cache->lock);
+  cache->slots[slot].buffer = buffer;
+  pthread_mutex_unlock(&cache->lock);
+}
+
+// The decode pipeline has gone away. Frames already decoded stay valid so
+// the renderer can keep holding or stepping through them.
+void frame_cache_detach_buffers(FRAME_CACHE_T *cache)
+{
+  int i;
+
+  pthread_mutex_lock(&cache->lock);
+  for (i = 0; i < cache->count; i++)
+  {
+    FRAME_CACHE_SLOT_T *s = &cache->slots[i];
+    s->buffer = NULL;
+    if (s->filling)
+    {
+      s->filling = 0;
+      s->frame = -1;
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+}
+
+int frame_cache_find_buffer(FRAME_CACHE_T *cache, void *buffer)
+{
+  int i, slot = -1;
+
+  pthread_mutex_lock(&cache->lock);
+  for (i = 0; i < cache->count; i++)
+  {
+    if (cache->slots[i].buffer == buffer)
+    {
+      slot = i;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return slot;
+}
+
+static int is_reusable(FRAME_CACHE_T *cache, int slot)
+{
+  return slot != cache->pinned && !cache->slots[slot].filling;
+}
+
+/***********************************************************
+ * Name: frame_cache_acquire
+ *
+ * Arguments:
+ *       FRAME_CACHE_T *cache - frame cache
+ *       double now - current time in seconds
+ *
+ * Description: Picks the slot egl_render should decode the next frame
+ *              into and marks it as filling. Empty slots are used first,
+ *              then the oldest frame outside the time window, then the
+ *              least recently used frame. The pinned slot is only reused
+ *              when there is nothing else, which is what happens with a
+ *              single slot.
+ *
+ * Returns: int - slot index, or -1 if every slot is busy
+ *
+ ***********************************************************/
+int frame_cache_acquire(FRAME_CACHE_T *cache, double now)
+{
+  int i, best = -1, found;
+
+  pthread_mutex_lock(&cache->lock);
+  for (i = 0; i < cache->count && best < 0; i++)
+  {
+    if (is_reusable(cache, i) && cache->slots[i].frame < 0)
+      best = i;
+  }
+  found = best >= 0;
+
+  // oldest frame that has fallen out of the time window
+  for (i = 0; i < cache->count && !found; i++)
+  {
+    FRAME_CACHE_SLOT_T *s = &cache->slots[i];
+    if (is_reusable(cache, i) && now - s->decodedSeconds > cache->windowSeconds &&
+        (best < 0 || s->frame < cache->slots[best].frame))
+      best = i;
+  }
+  found = best >= 0;
+
+  // least recently used frame
+  for (i = 0; i < cache->count && !found; i++)
+  {
+    if (is_reusable(cache, i) && (best < 0 || cache->slots[i].lastUsed < cache->slots[best].lastUsed))
+      best = i;
+  }
+
+  if (best < 0 && cache->pinned >= 0 && !cache->slots[cache->pinned].filling)
+    best = cache->pinned;
+
+  if (best >= 0)
+  {
+    if (cache->slots[best].frame >= 0)
+      cache->evictions++;
+    cache->slots[best].frame = -1;
+    cache->slots[best].filling = 1;
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return best;
+}
+
+long frame_cache_complete(FRAME_CACHE_T *cache, int slot, double now)
+{
+  long frame;
+
+  pthread_mutex_lock(&cache->lock);
+  FRAME_CACHE_SLOT_T *s = &cache->slots[slot];
+  frame = cache->nextFrame++;
+  s->frame = frame;
+  s->decodedSeconds = now;
+  s->lastUsed = ++cache->tick;
+  s->filling = 0;
+  pthread_mutex_unlock(&cache->lock);
+  return frame;
+}
+
+// The frame decoded into slot is not wanted, leave the slot empty.
+void frame_cache_discard(FRAME_CACHE_T *cache, int slot)
+{
+  pthread_mutex_lock(&cache->lock);
+  cache->slots[slot].frame = -1;
+  cache->slots[slot].filling = 0;
+  pthread_mutex_unlock(&cache->lock);
+}
+
+int frame_cache_newest(FRAME_CACHE_T *cache)
+{
+  int i, slot = -1;
+
+  pthread_mutex_lock(&cache->lock);
+  for (i = 0; i < cache->count; i++)
+  {
+    FRAME_CACHE_SLOT_T *s = &cache->slots[i];
+    if (!s->filling && s->frame >= 0 && (slot < 0 || s->frame > cache->slots[slot].frame))
+      slot = i;
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return slot;
+}
+
+// Finds a specific frame for stepping or reverse playback. Every call counts
+// towards the hit rate.
+int frame_cache_lookup(FRAME_CACHE_T *cache, long frame)
+{
+  int i, slot = -1;
+
+  pthread_mutex_lock(&cache->lock);
+  for (i = 0; i < cache->count && frame >= 0; i++)
+  {
+    FRAME_CACHE_SLOT_T *s = &cache->slots[i];
+    if (!s->filling && s->frame == frame)
+    {
+      slot = i;
+      s->lastUsed = ++cache->tick;
+      break;
+    }
+  }
+  if (slot >= 0)
+    cache->hits++;
+  else
+    cache->misses++;
+  pthread_mutex_unlock(&cache->lock);
+  return slot;
+}
+
+void frame_cache_pin(FRAME_CACHE_T *cache, int slot)
+{
+  pthread_mutex_lock(&cache->lock);
+  cache->pinned = slot;
+  if (slot >= 0)
+    cache->slots[slot].lastUsed = ++cache->tick;
+  pthread_mutex_unlock(&cache->lock);
+}
+
+long frame_cache_frame(FRAME_CACHE_T *cache, int slot)
+{
+  long frame;
+
+  pthread_mutex_lock(&cache->lock);
+  frame = slot >= 0 && slot < cache->count ? cache->slots[slot].frame : -1;
+  pthread_mutex_unlock(&cache->lock);
+  return frame;
+}
+
+// Average time between the decoded frames currently held, used to pace
+// reverse playback.
+double frame_cache_frame_period(FRAME_CACHE_T *cache)
+{
+  int i, first = -1, last = -1;
+  double period = DEFAULT_FRAME_PERIOD;
+
+  pthread_mutex_lock(&cache->lock);
+  for (i = 0; i < cache->count; i++)
+  {
+    FRAME_CACHE_SLOT_T *s = &cache->slots[i];
+    if (s->filling || s->frame < 0)
+      continue;
+    if (first < 0 || s->frame < cache->slots[first].frame)
+      first = i;
+    if (last < 0 || s->frame > cache->slots[last].frame)
+      last = i;
+  }
+  if (first >= 0 && cache->slots[last].frame > cache->slots[first].frame)
+  {
+    period = (cache->slots[last].decodedSeconds - cache->slots[first].decodedSeconds) /
+      (cache->slots[last].frame - cache->slots[first].frame);
+  }
+  pthread_mutex_unlock(&cache->lock);
+  return period > 0 ? period : DEFAULT_FRAME_PERIOD;
+}
+
+void frame_cache_get_stats(FRAME_CACHE_T *cache, FRAME_CACHE_STATS_T *stats)
+{
+  int i;
+
+  memset(stats, 0, sizeof(*stats));
+  pthread_mutex_lock(&cache->lock);
+  stats->hits = cache->hits;
+  stats->misses = cache->misses;
+  stats->evictions = cache->evictions;
+  stats->slots = cache->count;
+  for (i = 0; i < cache->count; i++)
+  {
+    if (!cache->slots[i].filling && cache->slots[i].frame >= 0)
+      stats->filled++;
+  }
+  stats->bytesAllocated = cache->frameBytes * cache->count;
+  stats->bytesFilled = cache->frameBytes * stats->filled;
+  pthread_mutex_unlock(&cache->lock);
+}
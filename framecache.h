@@ -0,0 +1,73 @@
+// Bounded cache of recently decoded video frames.
+//
+// Every slot is a texture wrapped in an EGLImage which egl_render decodes
+// into directly, so a cached frame can be put back on screen without going
+// near the decoder. The renderer pins the slot it is showing; the decoder is
+// only ever handed unpinned slots, choosing empty slots first, then frames
+// that have fallen out of the time window, then the least recently used.
+#pragma once
+
+#include <stddef.h>
+#include <pthread.h>
+
+#define FRAME_CACHE_MAX_SLOTS 32
+
+typedef struct
+{
+  unsigned int tex;
+  void *eglImage;
+  // OMX buffer header egl_render uses for this slot, NULL when no pipeline
+  void *buffer;
+  // decoded frame number, -1 when the slot holds nothing displayable
+  long frame;
+  double decodedSeconds;
+  unsigned long lastUsed;
+  int filling;
+} FRAME_CACHE_SLOT_T;
+
+typedef struct
+{
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+  int slots;
+  int filled;
+  size_t bytesAllocated;
+  size_t bytesFilled;
+} FRAME_CACHE_STATS_T;
+
+typedef struct
+{
+  FRAME_CACHE_SLOT_T slots[FRAME_CACHE_MAX_SLOTS];
+  int count;
+  int capacity;
+  size_t frameBytes;
+  double windowSeconds;
+  long nextFrame;
+  int pinned;
+  unsigned long tick;
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+  pthread_mutex_t lock;
+} FRAME_CACHE_T;
+
+int frame_cache_init(FRAME_CACHE_T *cache, size_t frameBytes, size_t budgetBytes, double windowSeconds);
+void frame_cache_destroy(FRAME_CACHE_T *cache);
+
+int frame_cache_add_slot(FRAME_CACHE_T *cache, unsigned int tex, void *eglImage);
+void frame_cache_attach_buffer(FRAME_CACHE_T *cache, int slot, void *buffer);
+void frame_cache_detach_buffers(FRAME_CACHE_T *cache);
+int frame_cache_find_buffer(FRAME_CACHE_T *cache, void *buffer);
+
+int frame_cache_acquire(FRAME_CACHE_T *cache, double now);
+long frame_cache_complete(FRAME_CACHE_T *cache, int slot, double now);
+void frame_cache_discard(FRAME_CACHE_T *cache, int slot);
+
+int frame_cache_newest(FRAME_CACHE_T *cache);
+int frame_cache_lookup(FRAME_CACHE_T *cache, long frame);
+void frame_cache_pin(FRAME_CACHE_T *cache, int slot);
+long frame_cache_frame(FRAME_CACHE_T *cache, int slot);
+double frame_cache_frame_period(FRAME_CACHE_T *cache);
+
+void frame_cache_get_stats(FRAME_CACHE_T *cache, FRAME_CACHE_STATS_T *stats);
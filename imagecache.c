@@ -0,0 +1,187 @@
+// GPU texture cache for still images, see imagecache.h
+
+#include <string.h>
+
+#include "imagecache.h"
+
+static IMAGE_CACHE_ENTRY_T *find_entry(IMAGE_CACHE_T *cache, const char *path);
+static int evict_one(IMAGE_CACHE_T *cache, int priority);
+
+void image_cache_init(IMAGE_CACHE_T *cache, size_t budgetBytes, IMAGE_UPLOAD_T upload, IMAGE_RELEASE_T release, void *userdata)
+{
+  memset(cache, 0, sizeof(*cache));
+  cache->budgetBytes = budgetBytes;
+  cache->upload = upload;
+  cache->release = release;
+  cache->userdata = userdata;
+}
+
+void image_cache_destroy(IMAGE_CACHE_T *cache)
+{
+  int i;
+  for (i = 0; i < cache->count; i++)
+  {
+    if (cache->entries[i].path[0] != '\0')
+      cache->release(cache->userdata, cache->entries[i].tex);
+  }
+  cache->count = 0;
+  cache->bytes = 0;
+}
+
+static IMAGE_CACHE_ENTRY_T *find_entry(IMAGE_CACHE_T *cache, const char *path)
+{
+  int i;
+  for (i = 0; i < cache->count; i++)
+  {
+    if (strcmp(cache->entries[i].path, path) == 0)
+      return &cache->entries[i];
+  }
+  return NULL;
+}
+
+// Looks up an image that is about to be shown. Counts towards the hit rate.
+IMAGE_CACHE_ENTRY_T *image_cache_get(IMAGE_CACHE_T *cache, const char *path)
+{
+  IMAGE_CACHE_ENTRY_T *entry = path[0] != '\0' ? find_entry(cache, path) : NULL;
+  if (entry != NULL)
+  {
+    entry->lastUsed = ++cache->tick;
+    cache->hits++;
+  }
+  else
+    cache->misses++;
+  return entry;
+}
+
+// Looks up an image without touching the LRU order or the hit rate, for
+// deciding what to preload.
+int image_cache_contains(IMAGE_CACHE_T *cache, const char *path)
+{
+  return path[0] != '\0' && find_entry(cache, path) != NULL;
+}
+
+// Evicts the unpinned entry with the lowest priority, least recently used
+// first among equals, as long as it is not above priority.
+static int evict_one(IMAGE_CACHE_T *cache, int priority)
+{
+  int i, lru = -1;
+
+  for (i = 0; i < cache->count; i++)
+  {
+    IMAGE_CACHE_ENTRY_T *e = &cache->entries[i];
+    if (e->path[0] == '\0' || e->pinned || e->priority > priority)
+      continue;
+    if (lru < 0 || e->priority < cache->entries[lru].priority ||
+        (e->priority == cache->entries[lru].priority && e->lastUsed < cache->entries[lru].lastUsed))
+      lru = i;
+  }
+  if (lru < 0)
+    return -1;
+
+  cache->release(cache->userdata, cache->entries[lru].tex);
+  cache->bytes -= cache->entries[lru].bytes;
+  // leave a hole rather than compacting, entries handed out stay put
+  memset(&cache->entries[lru], 0, sizeof(cache->entries[lru]));
+  cache->evictions++;
+  return 0;
+}
+
+/***********************************************************
+ * Name: image_cache_insert
+ *
+ * Arguments:
+ *       IMAGE_CACHE_T *cache - texture cache
+ *       const IMAGE_T *image - decoded image
+ *       int priority - how much the image is wanted, higher is sooner
+ *
+ * Description:   Uploads a decoded image, first evicting the lowest
+ *                priority, then least recently used, textures until it
+ *                fits in the budget. Pinned textures and ones with a
+ *                higher priority than the new image are never evicted,
+ *                so an image can be refused if everything else is on
+ *                screen or wanted sooner.
+ *
+ * Returns: IMAGE_CACHE_ENTRY_T * - new entry, or NULL if it did not fit
+ *
+ ***********************************************************/
+IMAGE_CACHE_ENTRY_T *image_cache_insert(IMAGE_CACHE_T *cache, const IMAGE_T *image, int priority)
+{
+  IMAGE_CACHE_ENTRY_T *entry;
+  size_t bytes = (size_t)image->width * image->height * 4;
+
+  if (image->pixels == NULL || bytes > cache->budgetBytes)
+    return NULL;
+
+  entry = find_entry(cache, image->path);
+  if (entry != NULL)
+    return entry;
+
+  while (cache->bytes + bytes > cache->budgetBytes)
+  {
+    if (evict_one(cache, priority) != 0)
+      return NULL;
+  }
+
+  entry = find_entry(cache, "");
+  if (entry == NULL && cache->count == IMAGE_CACHE_MAX_ENTRIES)
+  {
+    if (evict_one(cache, priority) != 0)
+      return NULL;
+    entry = find_entry(cache, "");
+  }
+  if (entry == NULL)
+    entry = &cache->entries[cache->count++];
+  memset(entry, 0, sizeof(*entry));
+  strcpy(entry->path, image->path);
+  entry->tex = cache->upload(cache->userdata, image);
+  entry->width = image->width;
+  entry->height = image->height;
+  entry->bytes = bytes;
+  entry->lastUsed = ++cache->tick;
+  entry->priority = priority;
+  cache->bytes += bytes;
+  return entry;
+}
+
+void image_cache_clear_priorities(IMAGE_CACHE_T *cache)
+{
+  int i;
+  for (i = 0; i < cache->count; i++)
+    cache->entries[i].priority = 0;
+}
+
+// Sets the priority of a cached image, if it is cached.
+void image_cache_set_priority(IMAGE_CACHE_T *cache, const char *path, int priority)
+{
+  IMAGE_CACHE_ENTRY_T *entry = path[0] != '\0' ? find_entry(cache, path) : NULL;
+  if (entry != NULL)
+    entry->priority = priority;
+}
+
+void image_cache_pin(IMAGE_CACHE_T *cache, IMAGE_CACHE_ENTRY_T *entry)
+{
+  entry->pinned++;
+}
+
+void image_cache_unpin(IMAGE_CACHE_T *cache, IMAGE_CACHE_ENTRY_T *entry)
+{
+  if (entry->pinned > 0)
+    entry->pinned--;
+}
+
+void image_cache_get_stats(IMAGE_CACHE_T *cache, IMAGE_CACHE_STATS_T *stats)
+{
+  int i;
+
+  stats->hits = cache->hits;
+  stats->misses = cache->misses;
+  stats->evictions = cache->evictions;
+  stats->entries = 0;
+  for (i = 0; i < cache->count; i++)
+  {
+    if (cache->entries[i].path[0] != '\0')
+      stats->entries++;
+  }
+  stats->bytes = cache->bytes;
+  stats->budgetBytes = cache->budgetBytes;
+}
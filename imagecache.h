@@ -0,0 +1,69 @@
+// GPU texture cache for still images with LRU eviction under a byte budget.
+//
+// Entries carry a priority set by the caller, e.g. how soon a preloaded cue
+// comes up. Eviction takes the lowest priority first and only uses LRU
+// order between equals, so an image never pushes out one that is wanted
+// sooner than itself.
+//
+// Only the render thread uses the cache. Uploading and releasing textures
+// go through callbacks so the eviction logic does not depend on GL.
+#pragma once
+
+#include <stddef.h>
+
+#include "imagedecode.h"
+
+#define IMAGE_CACHE_MAX_ENTRIES 128
+
+typedef unsigned int (*IMAGE_UPLOAD_T)(void *userdata, const IMAGE_T *image);
+typedef void (*IMAGE_RELEASE_T)(void *userdata, unsigned int tex);
+
+typedef struct
+{
+  char path[IMAGE_PATH_MAX];
+  unsigned int tex;
+  int width;
+  int height;
+  size_t bytes;
+  unsigned long lastUsed;
+  int pinned;
+  int priority;
+} IMAGE_CACHE_ENTRY_T;
+
+typedef struct
+{
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+  int entries;
+  size_t bytes;
+  size_t budgetBytes;
+} IMAGE_CACHE_STATS_T;
+
+typedef struct
+{
+  IMAGE_CACHE_ENTRY_T entries[IMAGE_CACHE_MAX_ENTRIES];
+  int count;
+  size_t bytes;
+  size_t budgetBytes;
+  unsigned long tick;
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+  IMAGE_UPLOAD_T upload;
+  IMAGE_RELEASE_T release;
+  void *userdata;
+} IMAGE_CACHE_T;
+
+void image_cache_init(IMAGE_CACHE_T *cache, size_t budgetBytes, IMAGE_UPLOAD_T upload, IMAGE_RELEASE_T release, void *userdata);
+void image_cache_destroy(IMAGE_CACHE_T *cache);
+
+IMAGE_CACHE_ENTRY_T *image_cache_get(IMAGE_CACHE_T *cache, const char *path);
+int image_cache_contains(IMAGE_CACHE_T *cache, const char *path);
+IMAGE_CACHE_ENTRY_T *image_cache_insert(IMAGE_CACHE_T *cache, const IMAGE_T *image, int priority);
+void image_cache_clear_priorities(IMAGE_CACHE_T *cache);
+void image_cache_set_priority(IMAGE_CACHE_T *cache, const char *path, int priority);
+void image_cache_pin(IMAGE_CACHE_T *cache, IMAGE_CACHE_ENTRY_T *entry);
+void image_cache_unpin(IMAGE_CACHE_T *cache, IMAGE_CACHE_ENTRY_T *entry);
+
+void image_cache_get_stats(IMAGE_CACHE_T *cache, IMAGE_CACHE_STATS_T *stats);
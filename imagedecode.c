@@ -0,0 +1,404 @@
+// JPEG/PNG still image decoding on a pool of worker threads, see imagedecode.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <unistd.h>
+
+#include <jpeglib.h>
+#include <png.h>
+
+#include "imagedecode.h"
+
+typedef struct
+{
+  struct jpeg_error_mgr pub;
+  jmp_buf jump;
+} JPEG_ERROR_T;
+
+static int decode_jpeg(FILE *in, int maxWidth, int maxHeight, IMAGE_T *image);
+static int decode_png(FILE *in, int maxWidth, int maxHeight, IMAGE_T *image);
+static int scale_to_fit(const unsigned char *src, int srcWidth, int srcHeight, int components,
+                        int maxWidth, int maxHeight, IMAGE_T *image);
+static void* image_worker_main(void *arg);
+static int active_count(IMAGE_LOADER_T *loader);
+
+/***********************************************************
+ * Name: image_decode_file
+ *
+ * Arguments:
+ *       const char *path - JPEG or PNG file
+ *       int maxWidth, maxHeight - size the image must fit in
+ *       IMAGE_T *image - receives the RGBA pixels
+ *
+ * Description:   Decodes an image and scales it down, keeping its aspect
+ *                ratio, so that it fits maxWidth x maxHeight. Images that
+ *                already fit are left at their own size. JPEGs are
+ *                reduced by the decoder's DCT scaling first which does
+ *                most of the work for large photos.
+ *
+ * Returns: int - 0 on success
+ *
+ ***********************************************************/
+int image_decode_file(const char *path, int maxWidth, int maxHeight, IMAGE_T *image)
+{
+  unsigned char magic[8];
+  FILE *in;
+  int status = -1;
+
+  memset(image, 0, sizeof(*image));
+  snprintf(image->path, sizeof(image->path), "%s", path);
+
+  if ((in = fopen(path, "rb")) == NULL)
+    return -2;
+
+  if (fread(magic, 1, sizeof(magic), in) == sizeof(magic))
+  {
+    rewind(in);
+    if (magic[0] == 0xFF && magic[1] == 0xD8)
+      status = decode_jpeg(in, maxWidth, maxHeight, image);
+    else if (png_sig_cmp(magic, 0, sizeof(magic)) == 0)
+      status = decode_png(in, maxWidth, maxHeight, image);
+  }
+
+  fclose(in);
+  return status;
+}
+
+void image_free(IMAGE_T *image)
+{
+  if (image == NULL)
+    return;
+  free(image->pixels);
+  free(image);
+}
+
+static void jpeg_error_exit(j_common_ptr cinfo)
+{
+  // the default handler calls exit(), a bad slide must not stop the show
+  JPEG_ERROR_T *error = (JPEG_ERROR_T *)cinfo->err;
+  longjmp(error->jump, 1);
+}
+
+static int decode_jpeg(FILE *in, int maxWidth, int maxHeight, IMAGE_T *image)
+{
+  struct jpeg_decompress_struct cinfo;
+  JPEG_ERROR_T error;
+  unsigned char *volatile rgb = NULL;
+  int status;
+
+  cinfo.err = jpeg_std_error(&error.pub);
+  error.pub.error_exit = jpeg_error_exit;
+  if (setjmp(error.jump))
+  {
+    jpeg_destroy_decompress(&cinfo);
+    free(rgb);
+    // jpeg_finish_decompress can still fail after the image was scaled
+    free(image->pixels);
+    image->pixels = NULL;
+    return -3;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_stdio_src(&cinfo, in);
+  jpeg_read_header(&cinfo, TRUE);
+
+  // largest DCT reduction that still leaves at least the target size
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = 1;
+  while (cinfo.scale_denom < 8 &&
+         (int)cinfo.image_width / (int)(cinfo.scale_denom * 2) >= maxWidth &&
+         (int)cinfo.image_height / (int)(cinfo.scale_denom * 2) >= maxHeight)
+    cinfo.scale_denom *= 2;
+  cinfo.out_color_space = JCS_RGB;
+  cinfo.dct_method = JDCT_IFAST;
+
+  jpeg_start_decompress(&cinfo);
+
+  size_t stride = cinfo.output_width * 3;
+  rgb = malloc(stride * cinfo.output_height);
+  if (rgb == NULL)
+  {
+    jpeg_destroy_decompress(&cinfo);
+    return -4;
+  }
+
+  while (cinfo.output_scanline < cinfo.output_height)
+  {
+    JSAMPROW row = rgb + cinfo.output_scanline * stride;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+
+  status = scale_to_fit(rgb, cinfo.output_width, cinfo.output_height, 3, maxWidth, maxHeight, image);
+
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  free(rgb);
+  return status;
+}
+
+static int decode_png(FILE *in, int maxWidth, int maxHeight, IMAGE_T *image)
+{
+  png_image png;
+  unsigned char *rgba;
+  int status;
+
+  memset(&png, 0, sizeof(png));
+  png.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_stdio(&png, in))
+    return -3;
+
+  png.format = PNG_FORMAT_RGBA;
+  rgba = malloc(PNG_IMAGE_SIZE(png));
+  if (rgba == NULL)
+  {
+    png_image_free(&png);
+    return -4;
+  }
+
+  if (!png_image_finish_read(&png, NULL, rgba, 0, NULL))
+  {
+    free(rgba);
+    return -3;
+  }
+
+  status = scale_to_fit(rgba, png.width, png.height, 4, maxWidth, maxHeight, image);
+  free(rgba);
+  return status;
+}
+
+// Box filter down to fit, expanding to RGBA on the way.
+static int scale_to_fit(const unsigned char *src, int srcWidth, int srcHeight, int components,
+                        int maxWidth, int maxHeight, IMAGE_T *image)
+{
+  int width = srcWidth, height = srcHeight;
+  int x, y;
+
+  if (width > maxWidth)
+  {
+    height = (int)((long)height * maxWidth / width);
+    width = maxWidth;
+  }
+  if (height > maxHeight)
+  {
+    width = (int)((long)width * maxHeight / height);
+    height = maxHeight;
+  }
+  if (width < 1)
+    width = 1;
+  if (height < 1)
+    height = 1;
+
+  image->pixels = malloc((size_t)width * height * 4);
+  if (image->pixels == NULL)
+    return -4;
+  image->width = width;
+  image->height = height;
+
+  for (y = 0; y < height; y++)
+  {
+    int y0 = (int)((long)y * srcHeight / height);
+    int y1 = (int)((long)(y + 1) * srcHeight / height);
+    if (y1 <= y0)
+      y1 = y0 + 1;
+
+    for (x = 0; x < width; x++)
+    {
+      int x0 = (int)((long)x * srcWidth / width);
+      int x1 = (int)((long)(x + 1) * srcWidth / width);
+      unsigned int sum[4] = { 0, 0, 0, 0 };
+      int sx, sy, c;
+      if (x1 <= x0)
+        x1 = x0 + 1;
+
+      for (sy = y0; sy < y1; sy++)
+      {
+        const unsigned char *p = src + ((size_t)sy * srcWidth + x0) * components;
+        for (sx = x0; sx < x1; sx++, p += components)
+        {
+          for (c = 0; c < components; c++)
+            sum[c] += p[c];
+        }
+      }
+
+      unsigned int count = (x1 - x0) * (y1 - y0);
+      unsigned char *dst = image->pixels + ((size_t)y * width + x) * 4;
+      for (c = 0; c < 3; c++)
+        dst[c] = sum[c] / count;
+      dst[3] = components == 4 ? sum[3] / count : 255;
+    }
+  }
+  return 0;
+}
+
+/***********************************************************
+ * Name: image_loader_init
+ *
+ * Arguments:
+ *       IMAGE_LOADER_T *loader - loader to start
+ *       int workers - decode threads, 0 for one per spare core
+ *       int maxWidth, maxHeight - size images are scaled to fit
+ *
+ * Description:   Starts the decode worker pool
+ *
+ * Returns: int - number of workers started
+ *
+ ***********************************************************/
+int image_loader_init(IMAGE_LOADER_T *loader, int workers, int maxWidth, int maxHeight)
+{
+  int i;
+
+  memset(loader, 0, sizeof(*loader));
+  pthread_mutex_init(&loader->lock, NULL);
+  pthread_cond_init(&loader->wake, NULL);
+  loader->maxWidth = maxWidth;
+  loader->maxHeight = maxHeight;
+
+  if (workers <= 0)
+  {
+    // leave a core for the render loop
+    workers = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+    if (workers < 1)
+      workers = 1;
+  }
+  if (workers > IMAGE_LOADER_MAX_WORKERS)
+    workers = IMAGE_LOADER_MAX_WORKERS;
+
+  for (i = 0; i < workers; i++)
+  {
+    if (pthread_create(&loader->workers[i], NULL, image_worker_main, loader) != 0)
+      break;
+    loader->workerCount++;
+  }
+  return loader->workerCount;
+}
+
+static int active_count(IMAGE_LOADER_T *loader)
+{
+  int i, count = 0;
+  for (i = 0; i < IMAGE_LOADER_MAX_WORKERS; i++)
+  {
+    if (loader->active[i][0] != '\0')
+      count++;
+  }
+  return count;
+}
+
+static void* image_worker_main(void *arg)
+{
+  IMAGE_LOADER_T *loader = arg;
+  int i, slot = -1;
+
+  pthread_mutex_lock(&loader->lock);
+  while (!loader->terminate)
+  {
+    if (loader->queueCount == 0)
+    {
+      pthread_cond_wait(&loader->wake, &loader->lock);
+      continue;
+    }
+
+    // claim an idle entry in the active table for the request we pick up
+    for (i = 0; i < IMAGE_LOADER_MAX_WORKERS && slot < 0; i++)
+    {
+      if (loader->active[i][0] == '\0')
+        slot = i;
+    }
+    memcpy(loader->active[slot], loader->queue[loader->queueHead], IMAGE_PATH_MAX);
+    loader->queueHead = (loader->queueHead + 1) % IMAGE_LOADER_QUEUE;
+    loader->queueCount--;
+    pthread_mutex_unlock(&loader->lock);
+
+    IMAGE_T *image = malloc(sizeof(*image));
+    if (image != NULL && image_decode_file(loader->active[slot], loader->maxWidth, loader->maxHeight, image) != 0)
+      printf("Failed to decode image %s\n", loader->active[slot]);
+
+    pthread_mutex_lock(&loader->lock);
+    if (image != NULL)
+    {
+      loader->done[(loader->doneHead + loader->doneCount) % IMAGE_LOADER_QUEUE] = image;
+      loader->doneCount++;
+    }
+    loader->active[slot][0] = '\0';
+    slot = -1;
+  }
+  pthread_mutex_unlock(&loader->lock);
+  return NULL;
+}
+
+int image_loader_pending(IMAGE_LOADER_T *loader, const char *path)
+{
+  int i, pending = 0;
+
+  pthread_mutex_lock(&loader->lock);
+  for (i = 0; i < loader->queueCount && !pending; i++)
+    pending = strcmp(loader->queue[(loader->queueHead + i) % IMAGE_LOADER_QUEUE], path) == 0;
+  for (i = 0; i < IMAGE_LOADER_MAX_WORKERS && !pending; i++)
+    pending = strcmp(loader->active[i], path) == 0;
+  for (i = 0; i < loader->doneCount && !pending; i++)
+    pending = strcmp(loader->done[(loader->doneHead + i) % IMAGE_LOADER_QUEUE]->path, path) == 0;
+  pthread_mutex_unlock(&loader->lock);
+  return pending;
+}
+
+// Queues an image for decoding. Returns -1 when the queue is full so the
+// caller can try again on a later frame.
+int image_loader_request(IMAGE_LOADER_T *loader, const char *path)
+{
+  int status = -1;
+
+  if (strlen(path) >= IMAGE_PATH_MAX)
+    return -2;
+
+  pthread_mutex_lock(&loader->lock);
+  // finished images wait in the same ring size, so count them too
+  if (loader->queueCount + active_count(loader) + loader->doneCount < IMAGE_LOADER_QUEUE)
+  {
+    int tail = (loader->queueHead + loader->queueCount) % IMAGE_LOADER_QUEUE;
+    strcpy(loader->queue[tail], path);
+    loader->queueCount++;
+    pthread_cond_signal(&loader->wake);
+    status = 0;
+  }
+  pthread_mutex_unlock(&loader->lock);
+  return status;
+}
+
+// Next finished image, or NULL. The caller owns it and frees it with
+// image_free(); pixels is NULL if decoding failed.
+IMAGE_T *image_loader_poll(IMAGE_LOADER_T *loader)
+{
+  IMAGE_T *image = NULL;
+
+  pthread_mutex_lock(&loader->lock);
+  if (loader->doneCount > 0)
+  {
+    image = loader->done[loader->doneHead];
+    loader->doneHead = (loader->doneHead + 1) % IMAGE_LOADER_QUEUE;
+    loader->doneCount--;
+  }
+  pthread_mutex_unlock(&loader->lock);
+  return image;
+}
+
+void image_loader_destroy(IMAGE_LOADER_T *loader)
+{
+  IMAGE_T *image;
+  int i;
+
+  pthread_mutex_lock(&loader->lock);
+  loader->terminate = 1;
+  pthread_cond_broadcast(&loader->wake);
+  pthread_mutex_unlock(&loader->lock);
+
+  for (i = 0; i < loader->workerCount; i++)
+    pthread_join(loader->workers[i], NULL);
+  loader->workerCount = 0;
+
+  while ((image = image_loader_poll(loader)) != NULL)
+    image_free(image);
+
+  pthread_cond_destroy(&loader->wake);
+  pthread_mutex_destroy(&loader->lock);
+}
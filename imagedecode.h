@@ -0,0 +1,49 @@
+// JPEG/PNG still image decoding on a pool of worker threads.
+//
+// Images are decoded and scaled down to fit the screen off the render
+// thread. The render thread polls for finished images and uploads them.
+#pragma once
+
+#include <pthread.h>
+
+#define IMAGE_PATH_MAX 256
+#define IMAGE_LOADER_MAX_WORKERS 8
+#define IMAGE_LOADER_QUEUE 64
+
+typedef struct
+{
+  char path[IMAGE_PATH_MAX];
+  int width;
+  int height;
+  // RGBA, width * height * 4 bytes, NULL if decoding failed
+  unsigned char *pixels;
+} IMAGE_T;
+
+typedef struct
+{
+  pthread_t workers[IMAGE_LOADER_MAX_WORKERS];
+  int workerCount;
+  int maxWidth;
+  int maxHeight;
+  // pending requests and finished images, both FIFO rings
+  char queue[IMAGE_LOADER_QUEUE][IMAGE_PATH_MAX];
+  int queueHead;
+  int queueCount;
+  // paths being decoded right now, empty string for idle workers
+  char active[IMAGE_LOADER_MAX_WORKERS][IMAGE_PATH_MAX];
+  IMAGE_T *done[IMAGE_LOADER_QUEUE];
+  int doneHead;
+  int doneCount;
+  int terminate;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+} IMAGE_LOADER_T;
+
+int image_decode_file(const char *path, int maxWidth, int maxHeight, IMAGE_T *image);
+void image_free(IMAGE_T *image);
+
+int image_loader_init(IMAGE_LOADER_T *loader, int workers, int maxWidth, int maxHeight);
+int image_loader_request(IMAGE_LOADER_T *loader, const char *path);
+int image_loader_pending(IMAGE_LOADER_T *loader, const char *path);
+IMAGE_T *image_loader_poll(IMAGE_LOADER_T *loader);
+void image_loader_destroy(IMAGE_LOADER_T *loader);
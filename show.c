@@ -0,0 +1,362 @@
+// Compiled show files, see show.h
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "show.h"
+
+static int table_fits(const SHOW_T *show, const SHOW_TABLE_T *table, size_t entrySize)
+{
+  if (table->count == 0)
+    return 1;
+  return table->offset >= sizeof(SHOW_HEADER_T) && table->offset % SHOW_ALIGN == 0 &&
+         table->offset <= show->size &&
+         table->count <= (show->size - table->offset) / entrySize;
+}
+
+/***********************************************************
+ * Name: show_open_image
+ *
+ * Arguments:
+ *       SHOW_T *show - receives the show
+ *       const void *image - compiled show, aligned to at least SHOW_ALIGN
+ *       size_t size - bytes in image
+ *
+ * Description:   Checks the header and that every table lies inside the
+ *                image. Entries are not looked at; the accessors check
+ *                each reference as it is followed.
+ *
+ * Returns: int - 0, or one of SHOW_ERROR_*
+ *
+ ***********************************************************/
+int show_open_image(SHOW_T *show, const void *image, size_t size)
+{
+  const SHOW_HEADER_T *header = image;
+
+  memset(show, 0, sizeof(*show));
+  if (size < sizeof(SHOW_HEADER_T) || memcmp(header->magic, SHOW_MAGIC, 4) != 0)
+    return SHOW_ERROR_NOT_SHOW;
+  if (header->version != SHOW_VERSION || header->headerSize != sizeof(SHOW_HEADER_T) ||
+      header->byteOrder != SHOW_BYTE_ORDER)
+    return SHOW_ERROR_VERSION;
+  if (header->size != size)
+    return SHOW_ERROR_CORRUPT;
+
+  show->base = image;
+  show->size = size;
+  show->header = header;
+  if (!table_fits(show, &header->clips, sizeof(SHOW_CLIP_T)) ||
+      !table_fits(show, &header->curves, sizeof(SHOW_CURVE_T)) ||
+      !table_fits(show, &header->meshes, sizeof(SHOW_MESH_T)) ||
+      !table_fits(show, &header->luts, sizeof(SHOW_LUT_T)) ||
+      !table_fits(show, &header->cues, sizeof(SHOW_CUE_T)) ||
+      !table_fits(show, &header->floats, sizeof(float)) ||
+      !table_fits(show, &header->strings, 1) ||
+      header->strings.count == 0 ||
+      show->base[header->strings.offset + header->strings.count - 1] != '\0')
+  {
+    memset(show, 0, sizeof(*show));
+    return SHOW_ERROR_CORRUPT;
+  }
+  return 0;
+}
+
+/***********************************************************
+ * Name: show_load
+ *
+ * Arguments:
+ *       SHOW_T *show - receives the show
+ *       const char *path - compiled show file
+ *
+ * Description:   Maps the file read-only and opens it in place. Pages
+ *                are only read from the file when something uses them.
+ *                Anything without the show magic is turned away after
+ *                reading just its header.
+ *
+ * Returns: int - 0, or one of SHOW_ERROR_*
+ *
+ ***********************************************************/
+int show_load(SHOW_T *show, const char *path)
+{
+  SHOW_HEADER_T header;
+  struct stat st;
+  void *image;
+  int fd, status;
+
+  memset(show, 0, sizeof(*show));
+  if ((fd = open(path, O_RDONLY)) < 0)
+    return SHOW_ERROR_OPEN;
+  if (fstat(fd, &st) != 0)
+  {
+    close(fd);
+    return SHOW_ERROR_OPEN;
+  }
+  // the player is usually handed a video, so look at the magic before
+  // mapping what could be gigabytes
+  if (st.st_size < (off_t)sizeof(SHOW_HEADER_T) ||
+      pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+      memcmp(header.magic, SHOW_MAGIC, 4) != 0)
+  {
+    close(fd);
+    return SHOW_ERROR_NOT_SHOW;
+  }
+  if (st.st_size > UINT32_MAX)
+  {
+    close(fd);
+    return SHOW_ERROR_CORRUPT;
+  }
+
+  image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED)
+    return SHOW_ERROR_OPEN;
+
+  if ((status = show_open_image(show, image, st.st_size)) != 0)
+  {
+    munmap(image, st.st_size);
+    return status;
+  }
+  show->mapped = 1;
+  return 0;
+}
+
+void show_unload(SHOW_T *show)
+{
+  if (show->mapped)
+    munmap((void *)show->base, show->size);
+  memset(show, 0, sizeof(*show));
+}
+
+const char *show_error(int error)
+{
+  switch (error)
+  {
+    case 0:
+      return "no error";
+    case SHOW_ERROR_OPEN:
+      return "could not open file";
+    case SHOW_ERROR_NOT_SHOW:
+      return "not a compiled show";
+    case SHOW_ERROR_VERSION:
+      return "compiled for a different version or byte order";
+    default:
+      return "corrupt";
+  }
+}
+
+uint32_t show_checksum(const void *data, size_t size)
+{
+  const unsigned char *bytes = data;
+  uint32_t hash = 2166136261u;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    hash = (hash ^ bytes[i]) * 16777619u;
+  return hash;
+}
+
+static int string_ok(const SHOW_T *show, uint32_t offset)
+{
+  return offset < show->header->strings.count;
+}
+
+static int floats_ok(const SHOW_T *show, uint32_t index, uint32_t count)
+{
+  return show_floats(show, index, count) != NULL;
+}
+
+static int reference_ok(int32_t reference, uint32_t count)
+{
+  return reference == SHOW_NONE || (reference >= 0 && (uint32_t)reference < count);
+}
+
+/***********************************************************
+ * Name: show_verify
+ *
+ * Arguments:
+ *       const SHOW_T *show - opened show
+ *
+ * Description:   Checks the checksum and every reference in the show.
+ *                This reads the whole image, so the player does not do
+ *                it; showc does after compiling and with --verify.
+ *
+ * Returns: int - 0 if the show is intact
+ *
+ ***********************************************************/
+int show_verify(const SHOW_T *show)
+{
+  const SHOW_HEADER_T *h = show->header;
+  int i;
+
+  if (h == NULL)
+    return -1;
+  if (show_checksum(show->base + sizeof(*h), show->size - sizeof(*h)) != h->checksum)
+    return -2;
+
+  for (i = 0; i < (int)h->clips.count; i++)
+  {
+    const SHOW_CLIP_T *clip = show_clip(show, i);
+    if (!string_ok(show, clip->name) || !string_ok(show, clip->path))
+      return -3;
+  }
+  for (i = 0; i < (int)h->curves.count; i++)
+  {
+    const SHOW_CURVE_T *curve = show_curve(show, i);
+    if (!string_ok(show, curve->name) || curve->count < 2 || curve->count > h->floats.count / 2 ||
+        !floats_ok(show, curve->points, curve->count * 2))
+      return -3;
+  }
+  for (i = 0; i < (int)h->meshes.count; i++)
+  {
+    const SHOW_MESH_T *mesh = show_mesh(show, i);
+    uint64_t floats = (uint64_t)mesh->columns * mesh->rows * 4;
+    if (!string_ok(show, mesh->name) || mesh->columns < 2 || mesh->rows < 2 ||
+        floats > h->floats.count || !floats_ok(show, mesh->vertices, floats))
+      return -3;
+  }
+  for (i = 0; i < (int)h->luts.count; i++)
+  {
+    const SHOW_LUT_T *lut = show_lut(show, i);
+    if (!string_ok(show, lut->name) || lut->size < 2 || lut->size > h->floats.count / 3 ||
+        !floats_ok(show, lut->entries, lut->size * 3))
+      return -3;
+  }
+  for (i = 0; i < (int)h->cues.count; i++)
+  {
+    const SHOW_CUE_T *cue = show_cue(show, i);
+    if (!reference_ok(cue->clip, h->clips.count) || !reference_ok(cue->curve, h->curves.count) ||
+        !reference_ok(cue->mesh, h->meshes.count) || !reference_ok(cue->lut, h->luts.count) ||
+        !string_ok(show, cue->still) ||
+        (i > 0 && !(cue->number > show_cue(show, i - 1)->number)))
+      return -3;
+  }
+  return 0;
+}
+
+static const void *entry(const SHOW_T *show, size_t tableOffset, int index, size_t entrySize)
+{
+  const SHOW_TABLE_T *table;
+
+  if (show->header == NULL)
+    return NULL;
+  table = (const SHOW_TABLE_T *)((const unsigned char *)show->header + tableOffset);
+  if (index < 0 || (uint32_t)index >= table->count)
+    return NULL;
+  return show->base + table->offset + index * entrySize;
+}
+
+int show_cue_count(const SHOW_T *show)
+{
+  return show->header != NULL ? (int)show->header->cues.count : 0;
+}
+
+const SHOW_CUE_T *show_cue(const SHOW_T *show, int index)
+{
+  return entry(show, offsetof(SHOW_HEADER_T, cues), index, sizeof(SHOW_CUE_T));
+}
+
+const SHOW_CLIP_T *show_clip(const SHOW_T *show, int index)
+{
+  return entry(show, offsetof(SHOW_HEADER_T, clips), index, sizeof(SHOW_CLIP_T));
+}
+
+const SHOW_CURVE_T *show_curve(const SHOW_T *show, int index)
+{
+  return entry(show, offsetof(SHOW_HEADER_T, curves), index, sizeof(SHOW_CURVE_T));
+}
+
+const SHOW_MESH_T *show_mesh(const SHOW_T *show, int index)
+{
+  return entry(show, offsetof(SHOW_HEADER_T, meshes), index, sizeof(SHOW_MESH_T));
+}
+
+const SHOW_LUT_T *show_lut(const SHOW_T *show, int index)
+{
+  return entry(show, offsetof(SHOW_HEADER_T, luts), index, sizeof(SHOW_LUT_T));
+}
+
+// NULL unless all count floats from index are in the image.
+const float *show_floats(const SHOW_T *show, uint32_t index, uint32_t count)
+{
+  const SHOW_TABLE_T *floats;
+
+  if (show->header == NULL)
+    return NULL;
+  floats = &show->header->floats;
+  if (index > floats->count || count > floats->count - index)
+    return NULL;
+  return (const float *)(show->base + floats->offset) + index;
+}
+
+// The string at offset, or "" if the offset is out of range. The string
+// table ends in a NUL, so any offset inside it gives a terminated string.
+const char *show_string(const SHOW_T *show, uint32_t offset)
+{
+  if (show->header == NULL || offset >= show->header->strings.count)
+    return "";
+  return (const char *)show->base + show->header->strings.offset + offset;
+}
+
+// The clip a show opens with: the first cue's, or failing that the first
+// clip. The path is copied because whoever plays it may outlive the
+// mapping, e.g. across a reload. NULL if the show has no clips; the
+// caller frees it.
+char *show_video_path(const SHOW_T *show)
+{
+  const SHOW_CUE_T *first = show_cue(show, 0);
+  const SHOW_CLIP_T *clip;
+
+  if ((first == NULL || (clip = show_clip(show, first->clip)) == NULL) &&
+      (clip = show_clip(show, 0)) == NULL)
+    return NULL;
+  return strdup(show_string(show, clip->path));
+}
+
+// Binary search for a cue by number, -1 if there is no such cue.
+int show_find_cue(const SHOW_T *show, float number)
+{
+  int low = 0, high = show_cue_count(show) - 1;
+
+  while (low <= high)
+  {
+    int middle = (low + high) / 2;
+    float found = show_cue(show, middle)->number;
+    if (found == number)
+      return middle;
+    if (found < number)
+      low = middle + 1;
+    else
+      high = middle - 1;
+  }
+  return -1;
+}
+
+// Value of a curve at t in [0, 1], interpolated linearly between points.
+// A missing or broken curve is the straight line.
+float show_curve_value(const SHOW_T *show, const SHOW_CURVE_T *curve, float t)
+{
+  const float *p;
+  uint32_t i;
+
+  if (t <= 0)
+    return 0;
+  if (t >= 1)
+    return 1;
+  if (curve == NULL || curve->count < 2 || curve->count > UINT32_MAX / 2 ||
+      (p = show_floats(show, curve->points, curve->count * 2)) == NULL)
+    return t;
+
+  for (i = 1; i < curve->count; i++)
+  {
+    const float *a = p + (i - 1) * 2, *b = p + i * 2;
+    if (t <= b[0])
+      return b[0] > a[0] ? a[1] + (b[1] - a[1]) * (t - a[0]) / (b[0] - a[0]) : b[1];
+  }
+  return p[(curve->count - 1) * 2 + 1];
+}
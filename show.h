@@ -0,0 +1,131 @@
+// Compiled show files.
+//
+// showc turns a show description (see showcompile.h) into a single binary
+// image: a header, fixed-size tables of clips, curves, meshes, LUTs and
+// cues, a block of floats and a block of strings. Every reference inside
+// the image is an offset or an index, never a pointer, so the player maps
+// the file read-only and uses it where it lies. Loading checks the header
+// and that each table fits the file; the accessors bounds-check whatever
+// they are given, so nothing is walked, copied or allocated on load.
+//
+// showc replaces a show by renaming a new file over it, which leaves a
+// mapped copy untouched until the player unloads it.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHOW_MAGIC "PSHW"
+#define SHOW_VERSION 1
+// written natively, so a file from a machine of the other endianness fails to load
+#define SHOW_BYTE_ORDER 0x01020304
+// tables start on this boundary
+#define SHOW_ALIGN 8
+// an unset clip, curve, mesh or LUT reference in a cue
+#define SHOW_NONE -1
+
+#define SHOW_ERROR_OPEN -1
+#define SHOW_ERROR_NOT_SHOW -2
+#define SHOW_ERROR_VERSION -3
+#define SHOW_ERROR_CORRUPT -4
+
+typedef struct
+{
+  uint32_t offset;
+  uint32_t count;
+} SHOW_TABLE_T;
+
+typedef struct
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t headerSize;
+  uint32_t byteOrder;
+  // whole image, which must be the whole file
+  uint32_t size;
+  // FNV-1a of everything after the header, checked by show_verify()
+  uint32_t checksum;
+  uint32_t reserved;
+  SHOW_TABLE_T clips;
+  SHOW_TABLE_T curves;
+  SHOW_TABLE_T meshes;
+  SHOW_TABLE_T luts;
+  SHOW_TABLE_T cues;
+  // curve points, mesh vertices and LUT entries
+  SHOW_TABLE_T floats;
+  // NUL-terminated, starting with the empty string at offset 0; count is bytes
+  SHOW_TABLE_T strings;
+} SHOW_HEADER_T;
+
+typedef struct
+{
+  uint32_t name;
+  uint32_t path;
+} SHOW_CLIP_T;
+
+// count (t, value) pairs from floats[points], t rising from 0 to 1
+typedef struct
+{
+  uint32_t name;
+  uint32_t points;
+  uint32_t count;
+} SHOW_CURVE_T;
+
+// columns * rows vertices of (x, y, u, v) from floats[vertices], row by row
+typedef struct
+{
+  uint32_t name;
+  uint16_t columns;
+  uint16_t rows;
+  uint32_t vertices;
+} SHOW_MESH_T;
+
+// size (r, g, b) entries from floats[entries]
+typedef struct
+{
+  uint32_t name;
+  uint32_t size;
+  uint32_t entries;
+} SHOW_LUT_T;
+
+// Cues are sorted by number. Clip, still, alpha, mesh and LUT track from
+// the cue before unless a cue sets them; fade and curve belong to the cue.
+typedef struct
+{
+  float number;
+  float fadeSeconds;
+  float alpha;
+  int32_t clip;
+  int32_t curve;
+  int32_t mesh;
+  int32_t lut;
+  // string, empty for no still
+  uint32_t still;
+} SHOW_CUE_T;
+
+typedef struct
+{
+  const unsigned char *base;
+  size_t size;
+  const SHOW_HEADER_T *header;
+  int mapped;
+} SHOW_T;
+
+int show_load(SHOW_T *show, const char *path);
+int show_open_image(SHOW_T *show, const void *image, size_t size);
+void show_unload(SHOW_T *show);
+int show_verify(const SHOW_T *show);
+uint32_t show_checksum(const void *data, size_t size);
+const char *show_error(int error);
+
+int show_cue_count(const SHOW_T *show);
+const SHOW_CUE_T *show_cue(const SHOW_T *show, int index);
+int show_find_cue(const SHOW_T *show, float number);
+const SHOW_CLIP_T *show_clip(const SHOW_T *show, int index);
+const SHOW_CURVE_T *show_curve(const SHOW_T *show, int index);
+const SHOW_MESH_T *show_mesh(const SHOW_T *show, int index);
+const SHOW_LUT_T *show_lut(const SHOW_T *show, int index);
+const float *show_floats(const SHOW_T *show, uint32_t index, uint32_t count);
+const char *show_string(const SHOW_T *show, uint32_t offset);
+char *show_video_path(const SHOW_T *show);
+float show_curve_value(const SHOW_T *show, const SHOW_CURVE_T *curve, float t);
@@ -0,0 +1,89 @@
+// showc: compiles a show description for the player.
+//
+//   showc <show.txt> <out.show>    compile, check and write
+//   showc --verify <file.show>     check a compiled show
+//
+// Writing renames the new file over the old one, so a running player can
+// be sent SIGHUP to pick it up.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "show.h"
+#include "showcompile.h"
+
+static void print_summary(const char *path, const SHOW_T *show)
+{
+  const SHOW_HEADER_T *h = show->header;
+
+  printf("%s: %u cues, %u clips, %u curves, %u meshes, %u luts, %lu bytes\n", path, h->cues.count,
+         h->clips.count, h->curves.count, h->meshes.count, h->luts.count, (unsigned long)show->size);
+}
+
+static int verify(const char *path)
+{
+  SHOW_T show;
+  int status;
+
+  if ((status = show_load(&show, path)) != 0)
+  {
+    printf("%s: %s\n", path, show_error(status));
+    return 1;
+  }
+  status = show_verify(&show);
+  if (status != 0)
+    printf("%s: %s\n", path, status == -2 ? "checksum mismatch" : "bad reference");
+  else
+    print_summary(path, &show);
+  show_unload(&show);
+  return status != 0;
+}
+
+int main(int argc, char **argv)
+{
+  SHOW_T show;
+  FILE *in;
+  void *image;
+  size_t size;
+  int errors;
+
+  if (argc == 3 && strcmp(argv[1], "--verify") == 0)
+    return verify(argv[2]);
+  if (argc != 3)
+  {
+    printf("Usage: %s <show.txt> <out.show>\n", argv[0]);
+    printf("       %s --verify <file.show>\n", argv[0]);
+    return 2;
+  }
+
+  if ((in = fopen(argv[1], "r")) == NULL)
+  {
+    printf("Could not open %s\n", argv[1]);
+    return 1;
+  }
+  errors = show_compile(in, argv[1], &image, &size);
+  fclose(in);
+  if (errors > 0)
+  {
+    printf("%s: %d error%s, nothing written\n", argv[1], errors, errors == 1 ? "" : "s");
+    return 1;
+  }
+
+  // check the image the way the player will see it before replacing anything
+  if (show_open_image(&show, image, size) != 0 || show_verify(&show) != 0)
+  {
+    printf("%s: compiled show failed its own checks\n", argv[1]);
+    free(image);
+    return 1;
+  }
+  if (show_write(argv[2], image, size) != 0)
+  {
+    printf("Could not write %s\n", argv[2]);
+    free(image);
+    return 1;
+  }
+  print_summary(argv[2], &show);
+  free(image);
+  return 0;
+}
@@ -0,0 +1,664 @@
+// Show compiler, see showcompile.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "show.h"
+#include "showcompile.h"
+
+#define SHOW_MAX_MESH_SIDE 256
+#define SHOW_MAX_LUT_SIZE 65536
+
+// the name comes first so every kind of definition sorts the same way
+typedef struct
+{
+  char *name;
+  int line;
+  char *path;
+} CLIP_SOURCE_T;
+
+typedef struct
+{
+  char *name;
+  int line;
+  // floats taken from the compiler's float block
+  uint32_t first;
+  uint32_t count;
+  int columns;
+  int rows;
+} TABLE_SOURCE_T;
+
+typedef struct
+{
+  int line;
+  float number;
+  float fadeSeconds;
+  float alpha;
+  int setAlpha;
+  // NULL when the cue does not mention it
+  char *clip;
+  char *still;
+  char *curve;
+  char *mesh;
+  char *lut;
+} CUE_SOURCE_T;
+
+typedef struct
+{
+  const char *source;
+  int line;
+  int errors;
+
+  CLIP_SOURCE_T *clips;
+  int clipCount, clipCapacity;
+  TABLE_SOURCE_T *curves;
+  int curveCount, curveCapacity;
+  TABLE_SOURCE_T *meshes;
+  int meshCount, meshCapacity;
+  TABLE_SOURCE_T *luts;
+  int lutCount, lutCapacity;
+  CUE_SOURCE_T *cues;
+  int cueCount, cueCapacity;
+
+  float *floats;
+  int floatCount, floatCapacity;
+  char *strings;
+  int stringBytes, stringCapacity;
+} COMPILER_T;
+
+static void error(COMPILER_T *c, int line, const char *message, const char *detail)
+{
+  if (detail != NULL)
+    printf("%s:%d: %s '%s'\n", c->source, line, message, detail);
+  else
+    printf("%s:%d: %s\n", c->source, line, message);
+  c->errors++;
+}
+
+// Makes room for one more item, doubling the allocation when it is full.
+static int reserve(COMPILER_T *c, void **items, int *capacity, int count, size_t size)
+{
+  if (count < *capacity)
+    return 0;
+
+  int grown = *capacity > 0 ? *capacity * 2 : 64;
+  void *more = realloc(*items, grown * size);
+  if (more == NULL)
+  {
+    error(c, c->line, "out of memory", NULL);
+    return -1;
+  }
+  *items = more;
+  *capacity = grown;
+  return 0;
+}
+
+static char *copy(COMPILER_T *c, const char *text)
+{
+  char *s = strdup(text);
+  if (s == NULL)
+    error(c, c->line, "out of memory", NULL);
+  return s;
+}
+
+static int valid_name(const char *name)
+{
+  if (*name == '\0' || strcmp(name, "none") == 0)
+    return 0;
+  for (; *name != '\0'; name++)
+  {
+    if (!isalnum((unsigned char)*name) && *name != '_' && *name != '-' && *name != '.')
+      return 0;
+  }
+  return 1;
+}
+
+static int parse_float(COMPILER_T *c, const char *token, float *value)
+{
+  char *end;
+
+  if (token == NULL)
+  {
+    error(c, c->line, "missing number", NULL);
+    return -1;
+  }
+  *value = strtof(token, &end);
+  if (*end != '\0' || end == token || !isfinite(*value))
+  {
+    error(c, c->line, "bad number", token);
+    return -1;
+  }
+  return 0;
+}
+
+static int parse_int(COMPILER_T *c, const char *token, int min, int max, int *value)
+{
+  char *end;
+  long n;
+
+  if (token == NULL)
+  {
+    error(c, c->line, "missing number", NULL);
+    return -1;
+  }
+  n = strtol(token, &end, 10);
+  if (*end != '\0' || end == token || n < min || n > max)
+  {
+    error(c, c->line, "bad count", token);
+    return -1;
+  }
+  *value = (int)n;
+  return 0;
+}
+
+static int add_float(COMPILER_T *c, float value)
+{
+  if (reserve(c, (void **)&c->floats, &c->floatCapacity, c->floatCount, sizeof(float)) != 0)
+    return -1;
+  c->floats[c->floatCount++] = value;
+  return 0;
+}
+
+// Reads the rest of the line as numbers into the float block.
+static int parse_floats(COMPILER_T *c, char **save, TABLE_SOURCE_T *table)
+{
+  char *token;
+  float value;
+
+  table->first = c->floatCount;
+  while ((token = strtok_r(NULL, " \t\r\n", save)) != NULL)
+  {
+    if (parse_float(c, token, &value) != 0 || add_float(c, value) != 0)
+      return -1;
+  }
+  table->count = c->floatCount - table->first;
+  return 0;
+}
+
+static TABLE_SOURCE_T *new_table(COMPILER_T *c, TABLE_SOURCE_T **tables, int *count, int *capacity, const char *name)
+{
+  TABLE_SOURCE_T *table;
+
+  if (name == NULL || !valid_name(name))
+  {
+    error(c, c->line, "bad name", name);
+    return NULL;
+  }
+  if (reserve(c, (void **)tables, capacity, *count, sizeof(TABLE_SOURCE_T)) != 0)
+    return NULL;
+  table = &(*tables)[(*count)++];
+  memset(table, 0, sizeof(*table));
+  table->line = c->line;
+  table->name = copy(c, name);
+  return table;
+}
+
+static void parse_clip(COMPILER_T *c, char **save)
+{
+  char *name = strtok_r(NULL, " \t\r\n", save);
+  char *path = strtok_r(NULL, " \t\r\n", save);
+
+  if (name == NULL || !valid_name(name))
+  {
+    error(c, c->line, "bad name", name);
+    return;
+  }
+  if (path == NULL)
+  {
+    error(c, c->line, "clip needs a path", name);
+    return;
+  }
+  if (strtok_r(NULL, " \t\r\n", save) != NULL)
+    error(c, c->line, "unexpected text after clip path", path);
+  if (reserve(c, (void **)&c->clips, &c->clipCapacity, c->clipCount, sizeof(CLIP_SOURCE_T)) != 0)
+    return;
+
+  CLIP_SOURCE_T *clip = &c->clips[c->clipCount++];
+  clip->line = c->line;
+  clip->name = copy(c, name);
+  clip->path = copy(c, path);
+}
+
+static void parse_curve(COMPILER_T *c, char **save)
+{
+  TABLE_SOURCE_T *curve = new_table(c, &c->curves, &c->curveCount, &c->curveCapacity,
+                                    strtok_r(NULL, " \t\r\n", save));
+  uint32_t i;
+
+  if (curve == NULL || parse_floats(c, save, curve) != 0)
+    return;
+  if (curve->count % 2 != 0 || curve->count < 4)
+  {
+    error(c, c->line, "curve needs at least two (t, value) points", curve->name);
+    return;
+  }
+
+  const float *p = c->floats + curve->first;
+  if (p[0] != 0 || p[curve->count - 2] != 1)
+    error(c, c->line, "curve must run from t = 0 to t = 1", curve->name);
+  for (i = 2; i < curve->count; i += 2)
+  {
+    if (!(p[i] > p[i - 2]))
+    {
+      error(c, c->line, "curve t must rise", curve->name);
+      break;
+    }
+  }
+  curve->count /= 2;
+}
+
+static void parse_mesh(COMPILER_T *c, char **save)
+{
+  TABLE_SOURCE_T *mesh = new_table(c, &c->meshes, &c->meshCount, &c->meshCapacity,
+                                   strtok_r(NULL, " \t\r\n", save));
+
+  if (mesh == NULL ||
+      parse_int(c, strtok_r(NULL, " \t\r\n", save), 2, SHOW_MAX_MESH_SIDE, &mesh->columns) != 0 ||
+      parse_int(c, strtok_r(NULL, " \t\r\n", save), 2, SHOW_MAX_MESH_SIDE, &mesh->rows) != 0 ||
+      parse_floats(c, save, mesh) != 0)
+    return;
+  if (mesh->count != (uint32_t)(mesh->columns * mesh->rows * 4))
+    error(c, c->line, "mesh needs columns * rows vertices of x y u v", mesh->name);
+}
+
+static void parse_lut(COMPILER_T *c, char **save)
+{
+  TABLE_SOURCE_T *lut = new_table(c, &c->luts, &c->lutCount, &c->lutCapacity,
+                                  strtok_r(NULL, " \t\r\n", save));
+  uint32_t i;
+
+  if (lut == NULL ||
+      parse_int(c, strtok_r(NULL, " \t\r\n", save), 2, SHOW_MAX_LUT_SIZE, &lut->columns) != 0 ||
+      parse_floats(c, save, lut) != 0)
+    return;
+  if (lut->count != (uint32_t)lut->columns * 3)
+  {
+    error(c, c->line, "lut needs size entries of r g b", lut->name);
+    return;
+  }
+  for (i = 0; i < lut->count; i++)
+  {
+    float v = c->floats[lut->first + i];
+    if (v < 0 || v > 1)
+    {
+      error(c, c->line, "lut values must be between 0 and 1", lut->name);
+      break;
+    }
+  }
+}
+
+static void parse_cue(COMPILER_T *c, char **save)
+{
+  CUE_SOURCE_T *cue;
+  char *token;
+
+  if (reserve(c, (void **)&c->cues, &c->cueCapacity, c->cueCount, sizeof(CUE_SOURCE_T)) != 0)
+    return;
+  cue = &c->cues[c->cueCount];
+  memset(cue, 0, sizeof(*cue));
+  cue->line = c->line;
+  if (parse_float(c, strtok_r(NULL, " \t\r\n", save), &cue->number) != 0)
+    return;
+  if (c->cueCount > 0 && !(cue->number > c->cues[c->cueCount - 1].number))
+    error(c, c->line, "cue numbers must rise", NULL);
+  c->cueCount++;
+
+  while ((token = strtok_r(NULL, " \t\r\n", save)) != NULL)
+  {
+    char *value = strchr(token, '=');
+    if (value == NULL || value[1] == '\0')
+    {
+      error(c, c->line, "expected key=value", token);
+      continue;
+    }
+    *value++ = '\0';
+
+    if (strcmp(token, "fade") == 0)
+    {
+      if (parse_float(c, value, &cue->fadeSeconds) == 0 && cue->fadeSeconds < 0)
+        error(c, c->line, "fade cannot be negative", value);
+    }
+    else if (strcmp(token, "alpha") == 0)
+    {
+      if (parse_float(c, value, &cue->alpha) == 0 && (cue->alpha < 0 || cue->alpha > 1))
+        error(c, c->line, "alpha must be between 0 and 1", value);
+      cue->setAlpha = 1;
+    }
+    else if (strcmp(token, "clip") == 0)
+      cue->clip = copy(c, value);
+    else if (strcmp(token, "still") == 0)
+      cue->still = copy(c, value);
+    else if (strcmp(token, "curve") == 0)
+      cue->curve = copy(c, value);
+    else if (strcmp(token, "mesh") == 0)
+      cue->mesh = copy(c, value);
+    else if (strcmp(token, "lut") == 0)
+      cue->lut = copy(c, value);
+    else
+      error(c, c->line, "unknown cue setting", token);
+  }
+}
+
+static int compare_names(const void *a, const void *b)
+{
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Sorts a table by name, so cues can find definitions by binary search and
+// duplicates end up next to each other.
+static void sort_names(COMPILER_T *c, void *items, int count, size_t size, const char *kind)
+{
+  int i;
+
+  qsort(items, count, size, compare_names);
+  for (i = 1; i < count; i++)
+  {
+    char *name = *(char **)((char *)items + i * size);
+    if (strcmp(name, *(char **)((char *)items + (i - 1) * size)) == 0)
+    {
+      int line = *(int *)((char *)items + i * size + sizeof(char *));
+      error(c, line, kind, name);
+    }
+  }
+}
+
+// Index of the named definition, SHOW_NONE for "none", or -2 if missing.
+static int32_t find(void *items, int count, size_t size, const char *name)
+{
+  char *key = (char *)name;
+  char *found;
+
+  if (strcmp(name, "none") == 0)
+    return SHOW_NONE;
+  found = bsearch(&key, items, count, size, compare_names);
+  return found != NULL ? (int32_t)((found - (char *)items) / size) : -2;
+}
+
+static int32_t resolve(COMPILER_T *c, int line, void *items, int count, size_t size, const char *name,
+                       int32_t previous, const char *kind)
+{
+  if (name == NULL)
+    return previous;
+  int32_t index = find(items, count, size, name);
+  if (index == -2)
+  {
+    error(c, line, kind, name);
+    return SHOW_NONE;
+  }
+  return index;
+}
+
+static uint32_t add_string(COMPILER_T *c, const char *s)
+{
+  int length = strlen(s) + 1;
+  uint32_t offset;
+
+  if (length == 1)
+    return 0;
+  while (c->stringBytes + length > c->stringCapacity)
+  {
+    int grown = c->stringCapacity > 0 ? c->stringCapacity * 2 : 4096;
+    char *more = realloc(c->strings, grown);
+    if (more == NULL)
+    {
+      error(c, c->line, "out of memory", NULL);
+      return 0;
+    }
+    c->strings = more;
+    c->stringCapacity = grown;
+  }
+  offset = c->stringBytes;
+  memcpy(c->strings + offset, s, length);
+  c->stringBytes += length;
+  return offset;
+}
+
+static uint32_t place(SHOW_TABLE_T *table, uint32_t offset, uint32_t count, size_t entrySize)
+{
+  table->offset = offset;
+  table->count = count;
+  offset += count * entrySize;
+  return (offset + SHOW_ALIGN - 1) & ~(uint32_t)(SHOW_ALIGN - 1);
+}
+
+// Lays out the image. Returns NULL if there were errors.
+static void *emit(COMPILER_T *c, size_t *size)
+{
+  SHOW_HEADER_T header;
+  unsigned char *image;
+  int32_t clip = SHOW_NONE, mesh = SHOW_NONE, lut = SHOW_NONE;
+  uint32_t still = 0;
+  float alpha = 1;
+  int i;
+
+  sort_names(c, c->clips, c->clipCount, sizeof(CLIP_SOURCE_T), "clip defined twice");
+  sort_names(c, c->curves, c->curveCount, sizeof(TABLE_SOURCE_T), "curve defined twice");
+  sort_names(c, c->meshes, c->meshCount, sizeof(TABLE_SOURCE_T), "mesh defined twice");
+  sort_names(c, c->luts, c->lutCount, sizeof(TABLE_SOURCE_T), "lut defined twice");
+  if (c->cueCount == 0)
+    error(c, c->line, "show has no cues", NULL);
+
+  // the empty string is always at offset 0
+  if ((c->strings = calloc(1, 4096)) == NULL)
+  {
+    error(c, c->line, "out of memory", NULL);
+    return NULL;
+  }
+  c->stringCapacity = 4096;
+  c->stringBytes = 1;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SHOW_MAGIC, 4);
+  header.version = SHOW_VERSION;
+  header.headerSize = sizeof(header);
+  header.byteOrder = SHOW_BYTE_ORDER;
+
+  SHOW_CLIP_T *clips = calloc(c->clipCount + 1, sizeof(SHOW_CLIP_T));
+  SHOW_CURVE_T *curves = calloc(c->curveCount + 1, sizeof(SHOW_CURVE_T));
+  SHOW_MESH_T *meshes = calloc(c->meshCount + 1, sizeof(SHOW_MESH_T));
+  SHOW_LUT_T *luts = calloc(c->lutCount + 1, sizeof(SHOW_LUT_T));
+  SHOW_CUE_T *cues = calloc(c->cueCount + 1, sizeof(SHOW_CUE_T));
+  image = NULL;
+  if (clips == NULL || curves == NULL || meshes == NULL || luts == NULL || cues == NULL)
+  {
+    error(c, c->line, "out of memory", NULL);
+    goto done;
+  }
+
+  for (i = 0; i < c->clipCount; i++)
+  {
+    clips[i].name = add_string(c, c->clips[i].name);
+    clips[i].path = add_string(c, c->clips[i].path);
+  }
+  for (i = 0; i < c->curveCount; i++)
+  {
+    curves[i].name = add_string(c, c->curves[i].name);
+    curves[i].points = c->curves[i].first;
+    curves[i].count = c->curves[i].count;
+  }
+  for (i = 0; i < c->meshCount; i++)
+  {
+    meshes[i].name = add_string(c, c->meshes[i].name);
+    meshes[i].columns = c->meshes[i].columns;
+    meshes[i].rows = c->meshes[i].rows;
+    meshes[i].vertices = c->meshes[i].first;
+  }
+  for (i = 0; i < c->lutCount; i++)
+  {
+    luts[i].name = add_string(c, c->luts[i].name);
+    luts[i].size = c->luts[i].columns;
+    luts[i].entries = c->luts[i].first;
+  }
+
+  for (i = 0; i < c->cueCount; i++)
+  {
+    CUE_SOURCE_T *source = &c->cues[i];
+    SHOW_CUE_T *cue = &cues[i];
+
+    clip = resolve(c, source->line, c->clips, c->clipCount, sizeof(CLIP_SOURCE_T), source->clip, clip, "no such clip");
+    mesh = resolve(c, source->line, c->meshes, c->meshCount, sizeof(TABLE_SOURCE_T), source->mesh, mesh, "no such mesh");
+    lut = resolve(c, source->line, c->luts, c->lutCount, sizeof(TABLE_SOURCE_T), source->lut, lut, "no such lut");
+    if (source->still != NULL)
+      still = strcmp(source->still, "none") == 0 ? 0 : add_string(c, source->still);
+    if (source->setAlpha)
+      alpha = source->alpha;
+
+    cue->number = source->number;
+    cue->fadeSeconds = source->fadeSeconds;
+    cue->alpha = alpha;
+    cue->clip = clip;
+    cue->curve = resolve(c, source->line, c->curves, c->curveCount, sizeof(TABLE_SOURCE_T), source->curve, SHOW_NONE, "no such curve");
+    cue->mesh = mesh;
+    cue->lut = lut;
+    cue->still = still;
+  }
+
+  uint32_t offset = place(&header.clips, (sizeof(header) + SHOW_ALIGN - 1) & ~(SHOW_ALIGN - 1), c->clipCount, sizeof(SHOW_CLIP_T));
+  offset = place(&header.curves, offset, c->curveCount, sizeof(SHOW_CURVE_T));
+  offset = place(&header.meshes, offset, c->meshCount, sizeof(SHOW_MESH_T));
+  offset = place(&header.luts, offset, c->lutCount, sizeof(SHOW_LUT_T));
+  offset = place(&header.cues, offset, c->cueCount, sizeof(SHOW_CUE_T));
+  offset = place(&header.floats, offset, c->floatCount, sizeof(float));
+  header.strings.offset = offset;
+  header.strings.count = c->stringBytes;
+  header.size = offset + c->stringBytes;
+
+  if (c->errors > 0 || (image = calloc(1, header.size)) == NULL)
+    goto done;
+
+  memcpy(image + header.clips.offset, clips, c->clipCount * sizeof(SHOW_CLIP_T));
+  memcpy(image + header.curves.offset, curves, c->curveCount * sizeof(SHOW_CURVE_T));
+  memcpy(image + header.meshes.offset, meshes, c->meshCount * sizeof(SHOW_MESH_T));
+  memcpy(image + header.luts.offset, luts, c->lutCount * sizeof(SHOW_LUT_T));
+  memcpy(image + header.cues.offset, cues, c->cueCount * sizeof(SHOW_CUE_T));
+  memcpy(image + header.floats.offset, c->floats, c->floatCount * sizeof(float));
+  memcpy(image + header.strings.offset, c->strings, c->stringBytes);
+  header.checksum = show_checksum(image + sizeof(header), header.size - sizeof(header));
+  memcpy(image, &header, sizeof(header));
+  *size = header.size;
+
+done:
+  free(clips);
+  free(curves);
+  free(meshes);
+  free(luts);
+  free(cues);
+  return image;
+}
+
+static void free_compiler(COMPILER_T *c)
+{
+  int i;
+
+  for (i = 0; i < c->clipCount; i++)
+  {
+    free(c->clips[i].name);
+    free(c->clips[i].path);
+  }
+  for (i = 0; i < c->curveCount; i++)
+    free(c->curves[i].name);
+  for (i = 0; i < c->meshCount; i++)
+    free(c->meshes[i].name);
+  for (i = 0; i < c->lutCount; i++)
+    free(c->luts[i].name);
+  for (i = 0; i < c->cueCount; i++)
+  {
+    free(c->cues[i].clip);
+    free(c->cues[i].still);
+    free(c->cues[i].curve);
+    free(c->cues[i].mesh);
+    free(c->cues[i].lut);
+  }
+  free(c->clips);
+  free(c->curves);
+  free(c->meshes);
+  free(c->luts);
+  free(c->cues);
+  free(c->floats);
+  free(c->strings);
+}
+
+/***********************************************************
+ * Name: show_compile
+ *
+ * Arguments:
+ *       FILE *in - show description
+ *       const char *source - name used in error messages
+ *       void **image - receives the compiled show, to be freed
+ *       size_t *size - receives its size
+ *
+ * Description:   Parses and checks a show description and lays it out
+ *                as a compiled show, see show.h
+ *
+ * Returns: int - number of errors, 0 if *image was set
+ *
+ ***********************************************************/
+int show_compile(FILE *in, const char *source, void **image, size_t *size)
+{
+  COMPILER_T c;
+  char *line = NULL, *save, *keyword;
+  size_t capacity = 0;
+
+  memset(&c, 0, sizeof(c));
+  c.source = source;
+  *image = NULL;
+  *size = 0;
+
+  while (getline(&line, &capacity, in) >= 0)
+  {
+    c.line++;
+    char *comment = strchr(line, '#');
+    if (comment != NULL)
+      *comment = '\0';
+    if ((keyword = strtok_r(line, " \t\r\n", &save)) == NULL)
+      continue;
+
+    if (strcmp(keyword, "clip") == 0)
+      parse_clip(&c, &save);
+    else if (strcmp(keyword, "curve") == 0)
+      parse_curve(&c, &save);
+    else if (strcmp(keyword, "mesh") == 0)
+      parse_mesh(&c, &save);
+    else if (strcmp(keyword, "lut") == 0)
+      parse_lut(&c, &save);
+    else if (strcmp(keyword, "cue") == 0)
+      parse_cue(&c, &save);
+    else
+      error(&c, c.line, "unknown definition", keyword);
+  }
+  free(line);
+
+  // run even after errors, so bad names and references are reported too
+  *image = emit(&c, size);
+  int errors = c.errors;
+  free_compiler(&c);
+  return errors;
+}
+
+// Writes the image next to path and renames it into place, so a player
+// with the old show mapped keeps its copy and never sees half a file.
+int show_write(const char *path, const void *image, size_t size)
+{
+  char temp[1024];
+  FILE *out;
+
+  snprintf(temp, sizeof(temp), "%s.%d.tmp", path, (int)getpid());
+  if ((out = fopen(temp, "wb")) == NULL)
+    return -1;
+  if (fwrite(image, 1, size, out) != size || fflush(out) != 0 || fsync(fileno(out)) != 0)
+  {
+    fclose(out);
+    unlink(temp);
+    return -1;
+  }
+  if (fclose(out) != 0 || rename(temp, path) != 0)
+  {
+    unlink(temp);
+    return -1;
+  }
+  return 0;
+}
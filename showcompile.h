@@ -0,0 +1,26 @@
+// Show compiler.
+//
+// A show description is a text file, one definition per line, '#' to the
+// end of a line is a comment:
+//
+//   clip <name> <path>
+//   curve <name> <t> <value> <t> <value> ...
+//   mesh <name> <columns> <rows> <x> <y> <u> <v> ...
+//   lut <name> <size> <r> <g> <b> ...
+//   cue <number> [clip=<name>] [still=<path>] [alpha=<0..1>] [fade=<seconds>]
+//       [curve=<name>] [mesh=<name>] [lut=<name>]
+//
+// Names may be used before they are defined. Curves run from t = 0 to 1,
+// meshes list columns * rows vertices row by row and LUT values are 0..1.
+// Cue numbers must rise. A cue keeps the previous cue's clip, still,
+// alpha, mesh and LUT unless it sets them; "none" clears one.
+//
+// Errors are printed as "<source>:<line>: <message>" and all of them are
+// reported, not just the first.
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+
+int show_compile(FILE *in, const char *source, void **image, size_t *size);
+int show_write(const char *path, const void *image, size_t size);
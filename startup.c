@@ -0,0 +1,107 @@
+// Time-to-first-frame probe, see startup.h
+
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "startup.h"
+
+typedef struct
+{
+  double begin;
+  double end;
+} STARTUP_PHASE_T;
+
+static const char *phaseNames[STARTUP_PHASE_COUNT] = {
+  "bcm_host_init",
+  "EGL/display",
+  "frame textures",
+  "file open/prefetch",
+  "OMX init",
+  "OMX components",
+  "port settings",
+  "first frame decoded",
+  "first frame shown",
+};
+
+static STARTUP_PHASE_T phases[STARTUP_PHASE_COUNT];
+static double startSeconds;
+static double startSinceBoot;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double clock_seconds(clockid_t clock)
+{
+  struct timespec t;
+  clock_gettime(clock, &t);
+  return (double)t.tv_nsec / 1000000000 + (double)t.tv_sec;
+}
+
+void startup_begin(void)
+{
+  startSeconds = clock_seconds(CLOCK_MONOTONIC);
+  startSinceBoot = clock_seconds(CLOCK_BOOTTIME);
+}
+
+// Only the first begin/end of a phase is kept, later ones (a pipeline
+// restart, say) are not part of start-up.
+void startup_phase_begin(int phase)
+{
+  double now = clock_seconds(CLOCK_MONOTONIC) - startSeconds;
+
+  pthread_mutex_lock(&lock);
+  if (phases[phase].begin == 0)
+    phases[phase].begin = now;
+  pthread_mutex_unlock(&lock);
+}
+
+void startup_phase_end(int phase)
+{
+  double now = clock_seconds(CLOCK_MONOTONIC) - startSeconds;
+
+  pthread_mutex_lock(&lock);
+  if (phases[phase].end == 0)
+    phases[phase].end = now;
+  pthread_mutex_unlock(&lock);
+}
+
+// Records an instant, such as the first frame, as a zero-length phase.
+void startup_mark(int phase)
+{
+  startup_phase_begin(phase);
+  startup_phase_end(phase);
+}
+
+int startup_done(int phase)
+{
+  int done;
+
+  pthread_mutex_lock(&lock);
+  done = phases[phase].end != 0;
+  pthread_mutex_unlock(&lock);
+  return done;
+}
+
+void startup_report(void)
+{
+  int i;
+
+  pthread_mutex_lock(&lock);
+  printf("\nStart-up phases (ms since start):\n");
+  for (i = 0; i < STARTUP_PHASE_COUNT; i++)
+  {
+    STARTUP_PHASE_T *p = &phases[i];
+    if (p->end == 0)
+      printf("  %-20s  not reached\n", phaseNames[i]);
+    else if (p->end == p->begin)
+      printf("  %-20s  at %8.1f\n", phaseNames[i], p->end * 1000);
+    else
+      printf("  %-20s  %8.1f -> %8.1f  (%.1f)\n", phaseNames[i],
+             p->begin * 1000, p->end * 1000, (p->end - p->begin) * 1000);
+  }
+
+  STARTUP_PHASE_T *shown = &phases[STARTUP_PHASE_FIRST_FRAME_SHOWN];
+  if (shown->end != 0)
+    printf("Time to first frame: %.1f ms (%.2f s since boot)\n",
+           shown->end * 1000, startSinceBoot + shown->end);
+  pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,25 @@
+// Time-to-first-frame probe.
+//
+// Each start-up phase records when it began and ended, relative to
+// startup_begin(). Phases run on different threads, so several can be
+// in progress at once. startup_report() prints them all together with
+// the time since boot, which is what matters after a power cut.
+#pragma once
+
+#define STARTUP_PHASE_BCM_HOST 0
+#define STARTUP_PHASE_EGL 1
+#define STARTUP_PHASE_TEXTURES 2
+#define STARTUP_PHASE_FILE_PREFETCH 3
+#define STARTUP_PHASE_OMX_INIT 4
+#define STARTUP_PHASE_COMPONENTS 5
+#define STARTUP_PHASE_PORT_SETTINGS 6
+#define STARTUP_PHASE_FIRST_FRAME_DECODED 7
+#define STARTUP_PHASE_FIRST_FRAME_SHOWN 8
+#define STARTUP_PHASE_COUNT 9
+
+void startup_begin(void);
+void startup_phase_begin(int phase);
+void startup_phase_end(int phase);
+void startup_mark(int phase);
+int startup_done(int phase);
+void startup_report(void);
@@ -0,0 +1,215 @@
+// Still image layer, see stills.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stills.h"
+
+#define CUE_DECODE_FAILED 1
+#define CUE_NO_ROOM 2
+
+static void request_cue(STILLS_T *stills, int cue);
+static int window_cue(STILLS_T *stills, int i);
+static int cue_priority(STILLS_T *stills, const char *path);
+static void prioritise_window(STILLS_T *stills);
+static void show_entry(STILLS_T *stills, IMAGE_CACHE_ENTRY_T *entry);
+
+/***********************************************************
+ * Name: stills_init
+ *
+ * Arguments:
+ *       STILLS_T *stills - layer to initialise
+ *       char **cues, int cueCount - image file for each cue
+ *       int workers - decode threads, 0 for one per spare core
+ *       int maxWidth, maxHeight - screen size images are scaled to fit
+ *       size_t budgetBytes - texture memory for cached images
+ *       upload, release, userdata - texture callbacks, see imagecache.h
+ *
+ * Description:   Starts the decode workers and preloads the first cues.
+ *                Nothing is shown until stills_go() is called.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void stills_init(STILLS_T *stills, char **cues, int cueCount, int workers, int maxWidth, int maxHeight,
+                 size_t budgetBytes, IMAGE_UPLOAD_T upload, IMAGE_RELEASE_T release, void *userdata)
+{
+  memset(stills, 0, sizeof(*stills));
+  stills->cues = cues;
+  stills->cueCount = cueCount;
+  stills->current = -1;
+  stills->preloadAhead = STILLS_PRELOAD_AHEAD;
+  stills->failed = calloc(cueCount > 0 ? cueCount : 1, 1);
+
+  image_cache_init(&stills->cache, budgetBytes, upload, release, userdata);
+  image_loader_init(&stills->loader, workers, maxWidth, maxHeight);
+
+  stills_update(stills);
+}
+
+void stills_destroy(STILLS_T *stills)
+{
+  image_loader_destroy(&stills->loader);
+  image_cache_destroy(&stills->cache);
+  free(stills->failed);
+  stills->showing = NULL;
+}
+
+static void request_cue(STILLS_T *stills, int cue)
+{
+  const char *path;
+
+  if (cue < 0 || cue >= stills->cueCount || stills->failed[cue])
+    return;
+  path = stills->cues[cue];
+  if (path[0] == '\0')
+    return;
+  if (!image_cache_contains(&stills->cache, path) && !image_loader_pending(&stills->loader, path))
+    image_loader_request(&stills->loader, path);
+}
+
+// The i'th cue of the preload window, current cue first.
+static int window_cue(STILLS_T *stills, int i)
+{
+  return stills->current < 0 ? i : stills->current + i;
+}
+
+// How soon an image is wanted: highest for the current cue, falling through
+// the preload window, and 0 for anything outside it.
+static int cue_priority(STILLS_T *stills, const char *path)
+{
+  int i, cue;
+
+  for (i = 0; i <= stills->preloadAhead; i++)
+  {
+    cue = window_cue(stills, i);
+    if (cue < stills->cueCount && strcmp(stills->cues[cue], path) == 0)
+      return stills->preloadAhead + 1 - i;
+  }
+  return 0;
+}
+
+static void prioritise_window(STILLS_T *stills)
+{
+  int i, cue;
+
+  image_cache_clear_priorities(&stills->cache);
+  // furthest first, so a path used twice in the window keeps the higher
+  for (i = stills->preloadAhead; i >= 0; i--)
+  {
+    cue = window_cue(stills, i);
+    if (cue < stills->cueCount)
+      image_cache_set_priority(&stills->cache, stills->cues[cue], stills->preloadAhead + 1 - i);
+  }
+}
+
+static void show_entry(STILLS_T *stills, IMAGE_CACHE_ENTRY_T *entry)
+{
+  if (stills->showing != NULL)
+    image_cache_unpin(&stills->cache, stills->showing);
+  stills->showing = entry;
+  if (entry != NULL)
+    image_cache_pin(&stills->cache, entry);
+}
+
+// Moves to a cue. If its image is not ready yet the previous image stays
+// on screen until stills_update() uploads it. Out of range clears the layer,
+// as does a cue with an empty path.
+void stills_go(STILLS_T *stills, int cue)
+{
+  IMAGE_CACHE_ENTRY_T *entry;
+  int i;
+
+  // the window has moved, so evictions may have room for these again
+  for (i = 0; i < stills->cueCount; i++)
+  {
+    if (stills->failed[i] == CUE_NO_ROOM)
+      stills->failed[i] = 0;
+  }
+
+  if (cue < 0 || cue >= stills->cueCount)
+  {
+    stills->current = -1;
+    show_entry(stills, NULL);
+    return;
+  }
+
+  stills->current = cue;
+  if (stills->cues[cue][0] == '\0')
+  {
+    show_entry(stills, NULL);
+    stills_update(stills);
+    return;
+  }
+  entry = image_cache_get(&stills->cache, stills->cues[cue]);
+  if (entry != NULL)
+    show_entry(stills, entry);
+  stills_update(stills);
+}
+
+/***********************************************************
+ * Name: stills_update
+ *
+ * Arguments:
+ *       STILLS_T *stills - still image layer
+ *
+ * Description:   Called once per frame on the render thread. Uploads at
+ *                most one finished image, so a burst of decodes cannot
+ *                stall a frame, then queues the current cue and the next
+ *                few for decoding if they are not cached. An image that
+ *                would only fit by evicting cues wanted sooner is dropped.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void stills_update(STILLS_T *stills)
+{
+  IMAGE_T *image;
+  int i;
+
+  if ((image = image_loader_poll(&stills->loader)) != NULL)
+  {
+    prioritise_window(stills);
+    IMAGE_CACHE_ENTRY_T *entry = image_cache_insert(&stills->cache, image, cue_priority(stills, image->path));
+    if (image->pixels == NULL || entry == NULL)
+    {
+      for (i = 0; i < stills->cueCount; i++)
+      {
+        if (strcmp(stills->cues[i], image->path) == 0)
+          stills->failed[i] = image->pixels == NULL ? CUE_DECODE_FAILED : CUE_NO_ROOM;
+      }
+    }
+    else
+      stills->uploads++;
+
+    if (entry != NULL && stills->current >= 0 &&
+        strcmp(stills->cues[stills->current], image->path) == 0)
+      show_entry(stills, entry);
+    image_free(image);
+  }
+
+  for (i = 0; i <= stills->preloadAhead; i++)
+    request_cue(stills, window_cue(stills, i));
+}
+
+// Replaces the cue list, e.g. when a show is reloaded. Images already in
+// the cache stay there and the current cue is kept if it still exists.
+void stills_set_cues(STILLS_T *stills, char **cues, int cueCount)
+{
+  unsigned char *failed = calloc(cueCount > 0 ? cueCount : 1, 1);
+
+  if (failed == NULL)
+    return;
+  free(stills->failed);
+  stills->failed = failed;
+  stills->cues = cues;
+  stills->cueCount = cueCount;
+  if (stills->current >= cueCount)
+    stills->current = cueCount - 1;
+}
+
+IMAGE_CACHE_ENTRY_T *stills_showing(STILLS_T *stills)
+{
+  return stills->showing;
+}
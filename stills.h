@@ -0,0 +1,36 @@
+// Still image layer: a list of image cues shown over the video.
+//
+// Going to a cue shows its image as soon as it is in the texture cache.
+// The next few cues are decoded ahead of time so that, in a running show,
+// the image is normally already uploaded when its cue comes. Cues in that
+// window are kept in the cache ahead of cues already passed, nearest first.
+#pragma once
+
+#include "imagedecode.h"
+#include "imagecache.h"
+
+#define STILLS_PRELOAD_AHEAD 3
+
+typedef struct
+{
+  IMAGE_LOADER_T loader;
+  IMAGE_CACHE_T cache;
+  char **cues;
+  int cueCount;
+  int current;
+  int preloadAhead;
+  // cues whose image could not be decoded, so they are not retried, or
+  // which did not fit in the cache, retried on the next cue
+  unsigned char *failed;
+  IMAGE_CACHE_ENTRY_T *showing;
+  unsigned long uploads;
+} STILLS_T;
+
+void stills_init(STILLS_T *stills, char **cues, int cueCount, int workers, int maxWidth, int maxHeight,
+                 size_t budgetBytes, IMAGE_UPLOAD_T upload, IMAGE_RELEASE_T release, void *userdata);
+void stills_destroy(STILLS_T *stills);
+
+void stills_set_cues(STILLS_T *stills, char **cues, int cueCount);
+void stills_go(STILLS_T *stills, int cue);
+void stills_update(STILLS_T *stills);
+IMAGE_CACHE_ENTRY_T *stills_showing(STILLS_T *stills);
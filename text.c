@@ -0,0 +1,353 @@
+// Text overlay, see text.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "text.h"
+
+// 5x7 font for ASCII 32-126, five columns per glyph, bit 0 the top row
+static const unsigned char font[(TEXT_LAST_CHAR - TEXT_FIRST_CHAR + 1) * TEXT_GLYPH_WIDTH] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, // space
+  0x00, 0x00, 0x5f, 0x00, 0x00, // !
+  0x00, 0x07, 0x00, 0x07, 0x00, // "
+  0x14, 0x7f, 0x14, 0x7f, 0x14, // #
+  0x24, 0x2a, 0x7f, 0x2a, 0x12, // $
+  0x23, 0x13, 0x08, 0x64, 0x62, // %
+  0x36, 0x49, 0x55, 0x22, 0x50, // &
+  0x00, 0x05, 0x03, 0x00, 0x00, // '
+  0x00, 0x1c, 0x22, 0x41, 0x00, // (
+  0x00, 0x41, 0x22, 0x1c, 0x00, // )
+  0x08, 0x2a, 0x1c, 0x2a, 0x08, // *
+  0x08, 0x08, 0x3e, 0x08, 0x08, // +
+  0x00, 0x50, 0x30, 0x00, 0x00, // ,
+  0x08, 0x08, 0x08, 0x08, 0x08, // -
+  0x00, 0x60, 0x60, 0x00, 0x00, // .
+  0x20, 0x10, 0x08, 0x04, 0x02, // /
+  0x3e, 0x51, 0x49, 0x45, 0x3e, // 0
+  0x00, 0x42, 0x7f, 0x40, 0x00, // 1
+  0x42, 0x61, 0x51, 0x49, 0x46, // 2
+  0x21, 0x41, 0x45, 0x4b, 0x31, // 3
+  0x18, 0x14, 0x12, 0x7f, 0x10, // 4
+  0x27, 0x45, 0x45, 0x45, 0x39, // 5
+  0x3c, 0x4a, 0x49, 0x49, 0x30, // 6
+  0x01, 0x71, 0x09, 0x05, 0x03, // 7
+  0x36, 0x49, 0x49, 0x49, 0x36, // 8
+  0x06, 0x49, 0x49, 0x29, 0x1e, // 9
+  0x00, 0x36, 0x36, 0x00, 0x00, // :
+  0x00, 0x56, 0x36, 0x00, 0x00, // ;
+  0x00, 0x08, 0x14, 0x22, 0x41, // <
+  0x14, 0x14, 0x14, 0x14, 0x14, // =
+  0x41, 0x22, 0x14, 0x08, 0x00, // >
+  0x02, 0x01, 0x51, 0x09, 0x06, // ?
+  0x32, 0x49, 0x79, 0x41, 0x3e, // @
+  0x7e, 0x11, 0x11, 0x11, 0x7e, // A
+  0x7f, 0x49, 0x49, 0x49, 0x36, // B
+  0x3e, 0x41, 0x41, 0x41, 0x22, // C
+  0x7f, 0x41, 0x41, 0x22, 0x1c, // D
+  0x7f, 0x49, 0x49, 0x49, 0x41, // E
+  0x7f, 0x09, 0x09, 0x01, 0x01, // F
+  0x3e, 0x41, 0x41, 0x51, 0x32, // G
+  0x7f, 0x08, 0x08, 0x08, 0x7f, // H
+  0x00, 0x41, 0x7f, 0x41, 0x00, // I
+  0x20, 0x40, 0x41, 0x3f, 0x01, // J
+  0x7f, 0x08, 0x14, 0x22, 0x41, // K
+  0x7f, 0x40, 0x40, 0x40, 0x40, // L
+  0x7f, 0x02, 0x04, 0x02, 0x7f, // M
+  0x7f, 0x04, 0x08, 0x10, 0x7f, // N
+  0x3e, 0x41, 0x41, 0x41, 0x3e, // O
+  0x7f, 0x09, 0x09, 0x09, 0x06, // P
+  0x3e, 0x41, 0x51, 0x21, 0x5e, // Q
+  0x7f, 0x09, 0x19, 0x29, 0x46, // R
+  0x46, 0x49, 0x49, 0x49, 0x31, // S
+  0x01, 0x01, 0x7f, 0x01, 0x01, // T
+  0x3f, 0x40, 0x40, 0x40, 0x3f, // U
+  0x1f, 0x20, 0x40, 0x20, 0x1f, // V
+  0x7f, 0x20, 0x18, 0x20, 0x7f, // W
+  0x63, 0x14, 0x08, 0x14, 0x63, // X
+  0x03, 0x04, 0x78, 0x04, 0x03, // Y
+  0x61, 0x51, 0x49, 0x45, 0x43, // Z
+  0x00, 0x7f, 0x41, 0x41, 0x00, // [
+  0x02, 0x04, 0x08, 0x10, 0x20, // backslash
+  0x00, 0x41, 0x41, 0x7f, 0x00, // ]
+  0x04, 0x02, 0x01, 0x02, 0x04, // ^
+  0x40, 0x40, 0x40, 0x40, 0x40, // _
+  0x00, 0x01, 0x02, 0x04, 0x00, // `
+  0x20, 0x54, 0x54, 0x54, 0x78, // a
+  0x7f, 0x48, 0x44, 0x44, 0x38, // b
+  0x38, 0x44, 0x44, 0x44, 0x20, // c
+  0x38, 0x44, 0x44, 0x48, 0x7f, // d
+  0x38, 0x54, 0x54, 0x54, 0x18, // e
+  0x08, 0x7e, 0x09, 0x01, 0x02, // f
+  0x0c, 0x52, 0x52, 0x52, 0x3e, // g
+  0x7f, 0x08, 0x04, 0x04, 0x78, // h
+  0x00, 0x44, 0x7d, 0x40, 0x00, // i
+  0x20, 0x40, 0x44, 0x3d, 0x00, // j
+  0x7f, 0x10, 0x28, 0x44, 0x00, // k
+  0x00, 0x41, 0x7f, 0x40, 0x00, // l
+  0x7c, 0x04, 0x18, 0x04, 0x78, // m
+  0x7c, 0x08, 0x04, 0x04, 0x78, // n
+  0x38, 0x44, 0x44, 0x44, 0x38, // o
+  0x7c, 0x14, 0x14, 0x14, 0x08, // p
+  0x08, 0x14, 0x14, 0x18, 0x7c, // q
+  0x7c, 0x08, 0x04, 0x04, 0x08, // r
+  0x48, 0x54, 0x54, 0x54, 0x20, // s
+  0x04, 0x3f, 0x44, 0x40, 0x20, // t
+  0x3c, 0x40, 0x40, 0x20, 0x7c, // u
+  0x1c, 0x20, 0x40, 0x20, 0x1c, // v
+  0x3c, 0x40, 0x30, 0x40, 0x3c, // w
+  0x44, 0x28, 0x10, 0x28, 0x44, // x
+  0x0c, 0x50, 0x50, 0x50, 0x3c, // y
+  0x44, 0x64, 0x54, 0x4c, 0x44, // z
+  0x00, 0x08, 0x36, 0x41, 0x00, // {
+  0x00, 0x00, 0x7f, 0x00, 0x00, // |
+  0x00, 0x41, 0x36, 0x08, 0x00, // }
+  0x04, 0x02, 0x04, 0x08, 0x04, // ~
+};
+
+static int power_of_two(int n)
+{
+  int p = 1;
+  while (p < n)
+    p *= 2;
+  return p;
+}
+
+static int font_pixel(int c, int x, int y)
+{
+  if (x < 0 || x >= TEXT_GLYPH_WIDTH || y < 0 || y >= TEXT_GLYPH_HEIGHT)
+    return 0;
+  return (font[(c - TEXT_FIRST_CHAR) * TEXT_GLYPH_WIDTH + x] >> y) & 1;
+}
+
+/***********************************************************
+ * Name: text_atlas_init
+ *
+ * Arguments:
+ *       TEXT_ATLAS_T *atlas - atlas to build
+ *       int scale - screen pixels per font pixel
+ *
+ * Description:   Rasterises every glyph of the built-in font at the
+ *                given scale, with a one pixel black outline so text
+ *                stays readable over any picture. Done once; the
+ *                renderer uploads the pixels as a luminance-alpha
+ *                texture.
+ *
+ * Returns: int - 0 on success, -1 if out of memory
+ *
+ ***********************************************************/
+int text_atlas_init(TEXT_ATLAS_T *atlas, int scale)
+{
+  int glyphs = TEXT_LAST_CHAR - TEXT_FIRST_CHAR + 1;
+  int rows = (glyphs + TEXT_ATLAS_COLUMNS - 1) / TEXT_ATLAS_COLUMNS;
+  int c, x, y;
+
+  memset(atlas, 0, sizeof(*atlas));
+  atlas->scale = scale > 0 ? scale : 1;
+  atlas->cellWidth = TEXT_GLYPH_WIDTH * atlas->scale + 2;
+  atlas->cellHeight = TEXT_GLYPH_HEIGHT * atlas->scale + 2;
+  atlas->width = power_of_two(TEXT_ATLAS_COLUMNS * atlas->cellWidth);
+  atlas->height = power_of_two(rows * atlas->cellHeight);
+  if ((atlas->pixels = calloc(atlas->width * atlas->height, 2)) == NULL)
+    return -1;
+
+  for (c = TEXT_FIRST_CHAR; c <= TEXT_LAST_CHAR; c++)
+  {
+    int cellX = (c - TEXT_FIRST_CHAR) % TEXT_ATLAS_COLUMNS * atlas->cellWidth;
+    int cellY = (c - TEXT_FIRST_CHAR) / TEXT_ATLAS_COLUMNS * atlas->cellHeight;
+
+    for (y = 0; y < atlas->cellHeight; y++)
+    {
+      for (x = 0; x < atlas->cellWidth; x++)
+      {
+        unsigned char *p = atlas->pixels + ((cellY + y) * atlas->width + cellX + x) * 2;
+        int dx, dy, near = 0;
+
+        // (x - 1, y - 1) is the scaled glyph pixel under this atlas pixel
+        if (x >= 1 && y >= 1 && font_pixel(c, (x - 1) / atlas->scale, (y - 1) / atlas->scale))
+        {
+          p[0] = 255;
+          p[1] = 255;
+          continue;
+        }
+        for (dy = -1; dy <= 1 && !near; dy++)
+        {
+          for (dx = -1; dx <= 1 && !near; dx++)
+          {
+            int gx = x - 1 + dx, gy = y - 1 + dy;
+            near = gx >= 0 && gy >= 0 && font_pixel(c, gx / atlas->scale, gy / atlas->scale);
+          }
+        }
+        if (near)
+          p[1] = 255;
+      }
+    }
+  }
+  return 0;
+}
+
+void text_atlas_destroy(TEXT_ATLAS_T *atlas)
+{
+  free(atlas->pixels);
+  atlas->pixels = NULL;
+}
+
+static float *quad_vertex(float *v, float x, float y, float u, float t)
+{
+  v[0] = x;
+  v[1] = y;
+  v[2] = u;
+  v[3] = t;
+  return v + TEXT_VERTEX_FLOATS;
+}
+
+/***********************************************************
+ * Name: text_layout
+ *
+ * Arguments:
+ *       const TEXT_ATLAS_T *atlas - glyph atlas
+ *       const char *text - string, '\n' starts a new line
+ *       float x, y - top left of the first character in screen pixels,
+ *                    y down
+ *       float *vertices - receives six x, y, u, v vertices per character
+ *       int maxChars - room in vertices
+ *
+ * Description:   Lays out a string as two triangles per character.
+ *                Spaces and characters past maxChars get degenerate
+ *                triangles, so a string's run of vertices is always the
+ *                same size; characters outside the font show as '?'.
+ *
+ * Returns: int - number of characters drawn
+ *
+ ***********************************************************/
+int text_layout(const TEXT_ATLAS_T *atlas, const char *text, float x, float y, float *vertices, int maxChars)
+{
+  float penX = x, penY = y;
+  float w = atlas->cellWidth, h = atlas->cellHeight;
+  float *v = vertices;
+  int i, drawn = 0;
+
+  for (i = 0; text[i] != '\0' && i < maxChars; i++)
+  {
+    int c = (unsigned char)text[i];
+
+    if (c == '\n')
+    {
+      penX = x;
+      penY += TEXT_LINE_HEIGHT * atlas->scale;
+      continue;
+    }
+    if (c < TEXT_FIRST_CHAR || c > TEXT_LAST_CHAR)
+      c = '?';
+    if (c != ' ')
+    {
+      float u0 = (float)((c - TEXT_FIRST_CHAR) % TEXT_ATLAS_COLUMNS * atlas->cellWidth) / atlas->width;
+      float t0 = (float)((c - TEXT_FIRST_CHAR) / TEXT_ATLAS_COLUMNS * atlas->cellHeight) / atlas->height;
+      float u1 = u0 + w / atlas->width, t1 = t0 + h / atlas->height;
+      // the cell starts one pixel before the glyph for the outline
+      float x0 = penX - 1, y0 = penY - 1, x1 = x0 + w, y1 = y0 + h;
+
+      v = quad_vertex(v, x0, y0, u0, t0);
+      v = quad_vertex(v, x0, y1, u0, t1);
+      v = quad_vertex(v, x1, y0, u1, t0);
+      v = quad_vertex(v, x1, y0, u1, t0);
+      v = quad_vertex(v, x0, y1, u0, t1);
+      v = quad_vertex(v, x1, y1, u1, t1);
+      drawn++;
+    }
+    penX += TEXT_ADVANCE * atlas->scale;
+  }
+
+  memset(v, 0, (vertices + maxChars * TEXT_CHAR_VERTICES * TEXT_VERTEX_FLOATS - v) * sizeof(float));
+  return drawn;
+}
+
+int text_layer_init(TEXT_LAYER_T *layer, int scale)
+{
+  memset(layer, 0, sizeof(*layer));
+  return text_atlas_init(&layer->atlas, scale);
+}
+
+void text_layer_destroy(TEXT_LAYER_T *layer)
+{
+  text_atlas_destroy(&layer->atlas);
+}
+
+// Adds an empty string at (x, y) in screen pixels. Returns its index, or
+// -1 if the layer is full.
+int text_layer_add(TEXT_LAYER_T *layer, float x, float y)
+{
+  TEXT_STRING_T *string;
+
+  if (layer->stringCount >= TEXT_MAX_STRINGS)
+    return -1;
+  string = &layer->strings[layer->stringCount];
+  string->x = x;
+  string->y = y;
+  string->text[0] = '\0';
+  return layer->stringCount++;
+}
+
+/***********************************************************
+ * Name: text_layer_set
+ *
+ * Arguments:
+ *       TEXT_LAYER_T *layer - text layer
+ *       int string - index from text_layer_add()
+ *       const char *text - new text, cut to TEXT_STRING_MAX - 1 chars
+ *
+ * Description:   Lays the string out again only if its text changed,
+ *                otherwise its vertices are reused as they are
+ *
+ * Returns: int - 1 if the string changed
+ *
+ ***********************************************************/
+int text_layer_set(TEXT_LAYER_T *layer, int string, const char *text)
+{
+  TEXT_STRING_T *s;
+
+  if (string < 0 || string >= layer->stringCount)
+    return 0;
+  s = &layer->strings[string];
+  if (strncmp(s->text, text, TEXT_STRING_MAX - 1) == 0)
+  {
+    layer->reuses++;
+    return 0;
+  }
+
+  snprintf(s->text, sizeof(s->text), "%s", text);
+  text_layout(&layer->atlas, s->text, s->x, s->y,
+              layer->vertices + string * TEXT_STRING_MAX * TEXT_CHAR_VERTICES * TEXT_VERTEX_FLOATS,
+              TEXT_STRING_MAX);
+  layer->layouts++;
+  return 1;
+}
+
+int text_layer_printf(TEXT_LAYER_T *layer, int string, const char *format, ...)
+{
+  char text[TEXT_STRING_MAX];
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  return text_layer_set(layer, string, text);
+}
+
+// Vertices to draw as GL_TRIANGLES, covering every string added.
+int text_layer_vertex_count(const TEXT_LAYER_T *layer)
+{
+  return layer->stringCount * TEXT_STRING_MAX * TEXT_CHAR_VERTICES;
+}
+
+// Formats a frame number as HH:MM:SS:FF.
+void text_timecode(char *out, size_t size, long frame, int fps)
+{
+  if (fps <= 0)
+    fps = 25;
+  if (frame < 0)
+    frame = 0;
+  long seconds = frame / fps;
+  snprintf(out, size, "%02ld:%02ld:%02ld:%02ld", seconds / 3600, seconds / 60 % 60, seconds % 60, frame % fps);
+}
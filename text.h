@@ -0,0 +1,71 @@
+// Text overlay: a built-in 5x7 font rasterised once into an atlas and
+// strings laid out as textured triangles for one batched draw.
+//
+// Each string owns a fixed run of vertices in the batch and is only laid
+// out again when its text changes, so an overlay that updates every frame
+// rewrites a few dozen vertices. Nothing here touches GL; the renderer
+// uploads the atlas pixels and draws the vertices.
+#pragma once
+
+#include <stddef.h>
+
+#define TEXT_FIRST_CHAR 32
+#define TEXT_LAST_CHAR 126
+#define TEXT_GLYPH_WIDTH 5
+#define TEXT_GLYPH_HEIGHT 7
+// glyph width plus one column between characters, in font pixels
+#define TEXT_ADVANCE 6
+#define TEXT_LINE_HEIGHT 9
+#define TEXT_ATLAS_COLUMNS 16
+
+#define TEXT_MAX_STRINGS 8
+#define TEXT_STRING_MAX 48
+// x, y, u, v
+#define TEXT_VERTEX_FLOATS 4
+#define TEXT_CHAR_VERTICES 6
+
+typedef struct
+{
+  // screen pixels per font pixel
+  int scale;
+  // power of two sizes, for GLES 1
+  int width;
+  int height;
+  // a scaled glyph with a one pixel outline all round
+  int cellWidth;
+  int cellHeight;
+  // luminance and alpha pairs: glyphs white, outlines black
+  unsigned char *pixels;
+} TEXT_ATLAS_T;
+
+typedef struct
+{
+  float x;
+  float y;
+  char text[TEXT_STRING_MAX];
+} TEXT_STRING_T;
+
+typedef struct
+{
+  TEXT_ATLAS_T atlas;
+  TEXT_STRING_T strings[TEXT_MAX_STRINGS];
+  int stringCount;
+  float vertices[TEXT_MAX_STRINGS * TEXT_STRING_MAX * TEXT_CHAR_VERTICES * TEXT_VERTEX_FLOATS];
+  // strings laid out because their text changed, and set to the same text
+  unsigned long layouts;
+  unsigned long reuses;
+} TEXT_LAYER_T;
+
+int text_atlas_init(TEXT_ATLAS_T *atlas, int scale);
+void text_atlas_destroy(TEXT_ATLAS_T *atlas);
+int text_layout(const TEXT_ATLAS_T *atlas, const char *text, float x, float y, float *vertices, int maxChars);
+
+int text_layer_init(TEXT_LAYER_T *layer, int scale);
+void text_layer_destroy(TEXT_LAYER_T *layer);
+int text_layer_add(TEXT_LAYER_T *layer, float x, float y);
+int text_layer_set(TEXT_LAYER_T *layer, int string, const char *text);
+int text_layer_printf(TEXT_LAYER_T *layer, int string, const char *format, ...)
+  __attribute__((format(printf, 3, 4)));
+int text_layer_vertex_count(const TEXT_LAYER_T *layer);
+
+void text_timecode(char *out, size_t size, long frame, int fps);
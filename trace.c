@@ -0,0 +1,243 @@
+// Session trace recorder, see trace.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "trace.h"
+
+// records are written out in blocks, enough of them queued to ride out a
+// slow write without holding up whoever is recording
+#define TRACE_BLOCKS 8
+#define TRACE_BLOCK_RECORDS 1024
+
+static FILE *out;
+static volatile int enabled;
+static double startSeconds;
+// records fill one block while the writer thread writes out the queued ones
+static TRACE_RECORD_T blocks[TRACE_BLOCKS][TRACE_BLOCK_RECORDS];
+static int blockRecords[TRACE_BLOCKS];
+static int filling;
+static int buffered;
+// oldest queued block and how many are queued, including one being written
+static int writing;
+static int queued;
+static int stopping;
+static int writeFailed;
+static unsigned long dropped;
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle = PTHREAD_COND_INITIALIZER;
+
+static double monotonic_seconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_nsec / 1000000000 + (double)t.tv_sec;
+}
+
+// Queues the block being filled for the writer and starts on the next.
+// Fails if every other block is still queued.
+static int hand_off_locked(void)
+{
+  if (queued == TRACE_BLOCKS - 1)
+    return -1;
+  if (buffered > 0)
+  {
+    blockRecords[filling] = buffered;
+    filling = (filling + 1) % TRACE_BLOCKS;
+    buffered = 0;
+    queued++;
+    pthread_cond_signal(&wake);
+  }
+  return 0;
+}
+
+// Writes out blocks as they are queued, so no recording thread ever waits
+// for the file.
+static void *write_main(void *arg)
+{
+  pthread_mutex_lock(&lock);
+  for (;;)
+  {
+    while (queued == 0 && !stopping)
+      pthread_cond_wait(&wake, &lock);
+    if (queued == 0)
+      break;
+
+    // recording never fills a queued block, so it can be written unlocked
+    TRACE_RECORD_T *records = blocks[writing];
+    int count = blockRecords[writing];
+    int skip = writeFailed;
+    pthread_mutex_unlock(&lock);
+    int failed = !skip && fwrite(records, sizeof(records[0]), count, out) != (size_t)count;
+    pthread_mutex_lock(&lock);
+
+    if (failed)
+    {
+      printf("Trace write failed, recording stopped\n");
+      writeFailed = 1;
+      enabled = 0;
+    }
+    writing = (writing + 1) % TRACE_BLOCKS;
+    queued--;
+    pthread_cond_broadcast(&idle);
+  }
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+// Starts recording to path. Returns 0 on success.
+int trace_open(const char *path)
+{
+  TRACE_HEADER_T header;
+
+  if ((out = fopen(path, "wb")) == NULL)
+    return -1;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TRACE_MAGIC, 4);
+  header.version = TRACE_VERSION;
+  header.recordSize = sizeof(TRACE_RECORD_T);
+  if (fwrite(&header, sizeof(header), 1, out) != 1)
+  {
+    fclose(out);
+    out = NULL;
+    return -1;
+  }
+
+  startSeconds = monotonic_seconds();
+  filling = 0;
+  buffered = 0;
+  writing = 0;
+  queued = 0;
+  stopping = 0;
+  writeFailed = 0;
+  dropped = 0;
+  if (pthread_create(&writer, NULL, write_main, NULL) != 0)
+  {
+    fclose(out);
+    out = NULL;
+    return -1;
+  }
+  enabled = 1;
+  return 0;
+}
+
+void trace_close(void)
+{
+  pthread_mutex_lock(&lock);
+  if (out == NULL)
+  {
+    pthread_mutex_unlock(&lock);
+    return;
+  }
+  enabled = 0;
+  while (queued > 0)
+    pthread_cond_wait(&idle, &lock);
+  hand_off_locked();
+  stopping = 1;
+  pthread_cond_signal(&wake);
+  pthread_mutex_unlock(&lock);
+
+  pthread_join(writer, NULL);
+  fclose(out);
+  out = NULL;
+  if (dropped > 0)
+    printf("Trace writer fell behind, %lu records dropped\n", dropped);
+}
+
+int trace_enabled(void)
+{
+  return enabled;
+}
+
+void trace_record(int type, int32_t a, int32_t b)
+{
+  if (!enabled)
+    return;
+
+  double now = monotonic_seconds();
+  pthread_mutex_lock(&lock);
+  if (enabled)
+  {
+    // every block full: the file is too slow, lose the record rather
+    // than hold up the caller
+    if (buffered == TRACE_BLOCK_RECORDS && hand_off_locked() != 0)
+    {
+      dropped++;
+      pthread_mutex_unlock(&lock);
+      return;
+    }
+    TRACE_RECORD_T *r = &blocks[filling][buffered++];
+    r->micros = (uint64_t)((now - startSeconds) * 1000000);
+    r->type = type;
+    r->reserved = 0;
+    r->a = a;
+    r->b = b;
+    r->padding = 0;
+    if (buffered == TRACE_BLOCK_RECORDS)
+      hand_off_locked();
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+/***********************************************************
+ * Name: trace_load
+ *
+ * Arguments:
+ *       const char *path - trace file
+ *       TRACE_T *trace - receives the records
+ *
+ * Description:   Reads a whole trace into memory, checking the header
+ *                matches this build's record layout
+ *
+ * Returns: int - 0 on success
+ *
+ ***********************************************************/
+int trace_load(const char *path, TRACE_T *trace)
+{
+  TRACE_HEADER_T header;
+  FILE *in;
+  long size;
+
+  memset(trace, 0, sizeof(*trace));
+  if ((in = fopen(path, "rb")) == NULL)
+    return -1;
+
+  if (fread(&header, sizeof(header), 1, in) != 1 ||
+      memcmp(header.magic, TRACE_MAGIC, 4) != 0 ||
+      header.version != TRACE_VERSION ||
+      header.recordSize != sizeof(TRACE_RECORD_T))
+  {
+    fclose(in);
+    return -2;
+  }
+
+  fseek(in, 0, SEEK_END);
+  size = ftell(in) - sizeof(header);
+  fseek(in, sizeof(header), SEEK_SET);
+
+  trace->count = size / sizeof(TRACE_RECORD_T);
+  trace->records = malloc((trace->count > 0 ? trace->count : 1) * sizeof(TRACE_RECORD_T));
+  if (trace->records == NULL ||
+      fread(trace->records, sizeof(TRACE_RECORD_T), trace->count, in) != (size_t)trace->count)
+  {
+    fclose(in);
+    trace_free(trace);
+    return -3;
+  }
+
+  fclose(in);
+  return 0;
+}
+
+void trace_free(TRACE_T *trace)
+{
+  free(trace->records);
+  trace->records = NULL;
+  trace->count = 0;
+}
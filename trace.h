@@ -0,0 +1,67 @@
+// Session trace recorder.
+//
+// Records what the player was asked to do and what it did: commands as the
+// decoder saw them, every read from the input file, decoded frames and
+// every rendered frame with its alpha. Records are fixed 24-byte entries
+// after a small header, buffered in memory and written in blocks by a
+// writer thread, so recording is cheap enough to leave on during a show.
+// Timestamps are 64 bits so a trace can cover the longest show.
+//
+// Set PROJECTION_TRACE=<file> to record. bench/replay.bin replays a trace.
+#pragma once
+
+#include <stdint.h>
+
+#define TRACE_MAGIC "PRTR"
+#define TRACE_VERSION 2
+
+// a = file size low 32 bits, b = high bits
+#define TRACE_FILE 0
+// a = input buffer size
+#define TRACE_INPUT 1
+// a = command, b = input buffers fed when the decoder saw it
+#define TRACE_COMMAND 2
+// a = bytes read, b = input buffers fed
+#define TRACE_READ 3
+// b = input buffers fed
+#define TRACE_REWIND 4
+// a = frame number, b = input buffers fed
+#define TRACE_DECODED 5
+// a = target alpha, b = speed, both in millionths
+#define TRACE_FADE 6
+// a = frame number on screen, b = alpha in millionths
+#define TRACE_FRAME 7
+// a = watchdog reason, b = input buffers fed when the decoder was restarted
+#define TRACE_RESTART 8
+
+typedef struct
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t recordSize;
+} TRACE_HEADER_T;
+
+typedef struct
+{
+  // microseconds since the trace was opened
+  uint64_t micros;
+  uint16_t type;
+  uint16_t reserved;
+  int32_t a;
+  int32_t b;
+  uint32_t padding;
+} TRACE_RECORD_T;
+
+typedef struct
+{
+  TRACE_RECORD_T *records;
+  int count;
+} TRACE_T;
+
+int trace_open(const char *path);
+void trace_close(void);
+void trace_record(int type, int32_t a, int32_t b);
+int trace_enabled(void);
+
+int trace_load(const char *path, TRACE_T *trace);
+void trace_free(TRACE_T *trace);
@@ -45,6 +45,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "EGL/eglext.h"
 
 #include "triangle.h"
+#include "fade.h"
+#include "trace.h"
+#include "stills.h"
+#include "startup.h"
+#include "show.h"
+#include "text.h"
 #ifndef VIDEO_H
   #include "video.h"
 #endif
@@ -55,6 +61,33 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define IMAGE_SIZE_WIDTH 1920
 #define IMAGE_SIZE_HEIGHT 1080
 
+// GPU memory for decoded frames kept for stepping, reverse and hold
+#define FRAME_CACHE_BUDGET (64 * 1024 * 1024)
+#define FRAME_CACHE_WINDOW_SECONDS 4.0
+
+// GPU memory for decoded still images
+#define STILLS_CACHE_BUDGET (32 * 1024 * 1024)
+
+// start deferred work anyway if no video frame has appeared by then
+#define DEFERRED_INIT_TIMEOUT 2.0
+
+// overlay text size: screen lines per font pixel, and lines from the top left
+#define OVERLAY_LINES_PER_PIXEL 360
+#define OVERLAY_MARGIN 4
+
+// transport controls arrive as SIGRTMIN + index into this table
+static const int transportCommands[] = {
+  VIDEO_COMMAND_PLAY,
+  VIDEO_COMMAND_PAUSE,
+  VIDEO_COMMAND_STEP_FORWARD,
+  VIDEO_COMMAND_STEP_BACK,
+  VIDEO_COMMAND_REVERSE,
+};
+#define TRANSPORT_SIGNALS (int)(sizeof(transportCommands) / sizeof(transportCommands[0]))
+
+// fade speed for a cue with no fade time
+#define INSTANT_FADE_SPEED 1000000.0f
+
 // #define ENABLE_TEXTURES
 
 #ifndef M_PI
@@ -70,26 +103,66 @@ typedef struct
   EGLDisplay display;
   EGLSurface surface;
   EGLContext context;
-  GLuint tex;
+// Decoded video frames, one texture per slot
+  FRAME_CACHE_T cache;
+  int slot;
+  long frame;
+  double frameSeconds;
+// Playback timing for the overlay, restarted whenever play starts
+  unsigned long droppedFrames;
+  long syncFrame;
+  double syncSeconds;
+// Set once the work not needed for the first frame has been started
+  int deferredInit;
 // Alpha channel
   float alpha;
 } CUBE_STATE_T;
 
 static void init_ogl(CUBE_STATE_T *state);
 static void redraw_scene(CUBE_STATE_T *state);
-static void init_textures(CUBE_STATE_T *state, char *filename);
+static void start_video(CUBE_STATE_T *state, char *filename);
+static void init_textures(CUBE_STATE_T *state);
+static void init_deferred(CUBE_STATE_T *state);
+static void update_frame(CUBE_STATE_T *state, VIDEO_THREAD_DATA_T *video);
+static void print_frame_cache_stats(CUBE_STATE_T *state);
+static void print_watchdog_stats(VIDEO_THREAD_DATA_T *video);
+static void draw_still(CUBE_STATE_T *state);
+static void init_overlay(CUBE_STATE_T *state);
+static void update_overlay(CUBE_STATE_T *state);
+static void draw_overlay(CUBE_STATE_T *state);
+static unsigned int upload_still(void *userdata, const IMAGE_T *image);
+static void release_still(void *userdata, unsigned int tex);
+static void print_stills_stats(STILLS_T *stills);
 static void exit_func(void);
 static void update_fade(CUBE_STATE_T *state, FADE_DATA_T *fade);
 static double seconds();
 static void stop_video_blocking(VIDEO_THREAD_DATA_T *video);
+static char *open_show(char *path);
+static void reload_show(void);
+static void go_to_cue(int cue);
 
 static volatile int terminate;
+static volatile sig_atomic_t nextCue;
+static volatile int reloadShow;
+static volatile sig_atomic_t requestedCommand = VIDEO_COMMAND_NULL;
 static CUBE_STATE_T _state, *state=&_state;
 
-static void* eglImage = 0;
 static pthread_t videoThread;
 static VIDEO_THREAD_DATA_T _video, *video=&_video;
 static FADE_DATA_T _fade, *fade=&_fade;
+static STILLS_T _stills, *stills=&_stills;
+static char **stillCues;
+static int stillCueCount;
+// compiled show given in place of a video, reloaded into the other slot on SIGHUP
+static SHOW_T shows[2], *show;
+static char *showPath;
+// a copy, as the decoder opens it again on every restart, after reloads too
+static char *showVideoPath;
+// rehearsal overlay, turned on with PROJECTION_OVERLAY=1
+static TEXT_LAYER_T _overlay, *overlay=&_overlay;
+static int overlayEnabled;
+static GLuint overlayTex;
+static int overlayCue, overlayTimecode, overlayDropped, overlaySync;
 
 static GLbyte quadx[4*3] = {
   -10, -10,  0,
@@ -103,6 +176,7 @@ static const GLfloat texCoords[4 * 2] = {
   0.f,  1.f,
   1.f,  1.f
 };
+static GLfloat stillx[4*3];
 static GLfloat colorx[4*4] = {
   1.0f, 1.0f, 1.0f, 1.0f,
   1.0f, 1.0f, 1.0f, 1.0f,
@@ -261,57 +335,302 @@ static void redraw_scene(CUBE_STATE_T *state)
   // draw first 4 vertices
   glDrawArrays( GL_TRIANGLE_STRIP, 0, 4);
 
+  draw_still(state);
+  draw_overlay(state);
+
   eglSwapBuffers(state->display, state->surface);
 }
 
 /***********************************************************
- * Name: init_textures
+ * Name: draw_still
  *
  * Arguments:
  *       CUBE_STATE_T *state - holds OGLES model info
- *       char *filename - filename of video texture
  *
- * Description:   Initialise OGL|ES texture surfaces to use image
- *                buffers
+ * Description:   Draws the current still image over the video,
+ *                letterboxed to keep its aspect ratio
  *
  * Returns: void
  *
  ***********************************************************/
-static void init_textures(CUBE_STATE_T *state, char *filename)
+static void draw_still(CUBE_STATE_T *state)
 {
+  IMAGE_CACHE_ENTRY_T *still = stills_showing(stills);
+  if (still == NULL)
+    return;
+
+  float sx = 10.f, sy = 10.f;
+  float imageAspect = (float)still->width / still->height;
+  float screenAspect = (float)state->screen_width / state->screen_height;
+  if (imageAspect > screenAspect)
+    sy *= screenAspect / imageAspect;
+  else
+    sx *= imageAspect / screenAspect;
+
+  stillx[0] = -sx; stillx[1] = -sy; stillx[2] = 0;
+  stillx[3] =  sx; stillx[4] = -sy; stillx[5] = 0;
+  stillx[6] = -sx; stillx[7] =  sy; stillx[8] = 0;
+  stillx[9] =  sx; stillx[10] = sy; stillx[11] = 0;
+
+  glVertexPointer(3, GL_FLOAT, 0, stillx);
+  #ifndef ENABLE_TEXTURES
+  glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glEnable(GL_TEXTURE_2D);
+  #endif
+  glBindTexture(GL_TEXTURE_2D, still->tex);
+
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+  // put the video quad back
+  glVertexPointer(3, GL_BYTE, 0, quadx);
   #ifdef ENABLE_TEXTURES
-  // load three texture buffers but use them on six OGL|ES texture surfaces
-  glGenTextures(1, &state->tex);
+  if (state->slot >= 0)
+    glBindTexture(GL_TEXTURE_2D, state->cache.slots[state->slot].tex);
+  #else
+  glDisable(GL_TEXTURE_2D);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  #endif
+}
 
-  glBindTexture(GL_TEXTURE_2D, state->tex);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, IMAGE_SIZE_WIDTH, IMAGE_SIZE_HEIGHT, 0,
-           GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+/***********************************************************
+ * Name: init_overlay
+ *
+ * Arguments:
+ *       CUBE_STATE_T *state - holds OGLES model info
+ *
+ * Description:   Builds the glyph atlas for the screen size and uploads
+ *                it once as a luminance-alpha texture
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void init_overlay(CUBE_STATE_T *state)
+{
+  int scale = state->screen_height / OVERLAY_LINES_PER_PIXEL;
+  if (text_layer_init(overlay, scale) != 0) {
+    printf("Could not build overlay font\n");
+    return;
+  }
 
+  glGenTextures(1, &overlayTex);
+  glBindTexture(GL_TEXTURE_2D, overlayTex);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, overlay->atlas.width, overlay->atlas.height, 0,
+               GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, overlay->atlas.pixels);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  #ifdef ENABLE_TEXTURES
+  if (state->slot >= 0)
+    glBindTexture(GL_TEXTURE_2D, state->cache.slots[state->slot].tex);
+  #endif
+
+  float x = OVERLAY_MARGIN * overlay->atlas.scale, line = TEXT_LINE_HEIGHT * overlay->atlas.scale;
+  overlayCue = text_layer_add(overlay, x, x);
+  overlayTimecode = text_layer_add(overlay, x, x + line);
+  overlayDropped = text_layer_add(overlay, x, x + line * 2);
+  overlaySync = text_layer_add(overlay, x, x + line * 3);
+  overlayEnabled = 1;
+}
+
+// Sets this frame's overlay strings; unchanged ones keep their vertices.
+static void update_overlay(CUBE_STATE_T *state)
+{
+  char timecode[32];
+  const SHOW_CUE_T *cue;
+
+  if (!overlayEnabled)
+    return;
+
+  if (!state->deferredInit || stills->current < 0)
+    text_layer_set(overlay, overlayCue, "Cue -");
+  else if (show != NULL && (cue = show_cue(show, stills->current)) != NULL)
+    text_layer_printf(overlay, overlayCue, "Cue %g", cue->number);
+  else
+    text_layer_printf(overlay, overlayCue, "Cue %d", stills->current + 1);
+
+  double period = frame_cache_frame_period(&state->cache);
+  text_timecode(timecode, sizeof(timecode), state->frame, (int)(1.0 / period + 0.5));
+  text_layer_printf(overlay, overlayTimecode, "TC %s", timecode);
+  text_layer_printf(overlay, overlayDropped, "Dropped %lu", state->droppedFrames);
+  if (state->syncSeconds > 0)
+    text_layer_printf(overlay, overlaySync, "Sync %+.1f ms",
+                      (seconds() - state->syncSeconds - (state->frame - state->syncFrame) * period) * 1000);
+  else
+    text_layer_set(overlay, overlaySync, "Sync -");
+}
+
+/***********************************************************
+ * Name: draw_overlay
+ *
+ * Arguments:
+ *       CUBE_STATE_T *state - holds OGLES model info
+ *
+ * Description:   Draws every overlay string in one GL_TRIANGLES call
+ *                from the glyph atlas, in screen pixels from the top left
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void draw_overlay(CUBE_STATE_T *state)
+{
+  if (!overlayEnabled)
+    return;
 
-  /* Create EGL Image */
-  eglImage = eglCreateImageKHR(
-           state->display,
-           state->context,
-           EGL_GL_TEXTURE_2D_KHR,
-           (EGLClientBuffer)state->tex,
-           0);
-   
-  if (eglImage == EGL_NO_IMAGE_KHR)
+  glMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  glLoadIdentity();
+  glOrthof(0, state->screen_width, state->screen_height, 0, -1, 1);
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+  // y runs down, which flips the winding
+  glDisable(GL_CULL_FACE);
+
+  glDisableClientState(GL_COLOR_ARRAY);
+  glColor4f(1.f, 1.f, 1.f, 1.f);
+  glVertexPointer(2, GL_FLOAT, TEXT_VERTEX_FLOATS * sizeof(float), overlay->vertices);
+  glTexCoordPointer(2, GL_FLOAT, TEXT_VERTEX_FLOATS * sizeof(float), overlay->vertices + 2);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, overlayTex);
+
+  glDrawArrays(GL_TRIANGLES, 0, text_layer_vertex_count(overlay));
+
+  // put the video quad back
+  glEnable(GL_CULL_FACE);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(3, GL_BYTE, 0, quadx);
+  #ifdef ENABLE_TEXTURES
+  glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+  if (state->slot >= 0)
+    glBindTexture(GL_TEXTURE_2D, state->cache.slots[state->slot].tex);
+  #else
+  glDisable(GL_TEXTURE_2D);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  #endif
+  glPopMatrix();
+  glMatrixMode(GL_PROJECTION);
+  glPopMatrix();
+  glMatrixMode(GL_MODELVIEW);
+}
+
+// Texture callbacks for the still image cache, always on the render thread
+static unsigned int upload_still(void *userdata, const IMAGE_T *image)
+{
+  GLuint tex;
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->width, image->height, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, image->pixels);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  return tex;
+}
+
+static void release_still(void *userdata, unsigned int tex)
+{
+  GLuint t = tex;
+  glDeleteTextures(1, &t);
+}
+
+static void print_stills_stats(STILLS_T *stills)
+{
+  IMAGE_CACHE_STATS_T stats;
+  image_cache_get_stats(&stills->cache, &stats);
+
+  unsigned long lookups = stats.hits + stats.misses;
+  printf("Stills cache: %d images, %zu/%zu bytes, %lu hits, %lu misses (%.1f%%), %lu evictions, %lu uploads\n",
+         stats.entries, stats.bytes, stats.budgetBytes, stats.hits, stats.misses,
+         lookups ? 100.0 * stats.hits / lookups : 0.0, stats.evictions, stills->uploads);
+}
+
+/***********************************************************
+ * Name: start_video
+ *
+ * Arguments:
+ *       CUBE_STATE_T *state - holds OGLES model info
+ *       char *filename - filename of video texture
+ *
+ * Description:   Starts the video thread before EGL is up. It opens the
+ *                file, creates the OMX components and starts decoding in
+ *                parallel with init_ogl(), and only waits for the frame
+ *                textures once the decoder knows the output format.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void start_video(CUBE_STATE_T *state, char *filename)
+{
+  frame_cache_init(&state->cache, IMAGE_SIZE_WIDTH * IMAGE_SIZE_HEIGHT * 4,
+                   FRAME_CACHE_BUDGET, FRAME_CACHE_WINDOW_SECONDS);
+  state->slot = -1;
+  state->frame = -1;
+
+  video_init(video, filename, &state->cache);
+  pthread_create(&videoThread, NULL, video_decode_main, video);
+}
+
+/***********************************************************
+ * Name: init_textures
+ *
+ * Arguments:
+ *       CUBE_STATE_T *state - holds OGLES model info
+ *
+ * Description:   Initialise OGL|ES texture surfaces to use image
+ *                buffers, then lets the video thread use them
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void init_textures(CUBE_STATE_T *state)
+{
+  int slots = state->cache.capacity;
+
+  #ifdef ENABLE_TEXTURES
+  // one texture and EGL image per cached frame, egl_render decodes straight into them
+  int i;
+  for (i = 0; i < slots; i++)
   {
-    printf("eglCreateImageKHR failed.\n");
-    exit(1);
+    GLuint tex;
+    glGenTextures(1, &tex);
+
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, IMAGE_SIZE_WIDTH, IMAGE_SIZE_HEIGHT, 0,
+             GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    /* Create EGL Image */
+    void *eglImage = eglCreateImageKHR(
+             state->display,
+             state->context,
+             EGL_GL_TEXTURE_2D_KHR,
+             (EGLClientBuffer)tex,
+             0);
+     
+    if (eglImage == EGL_NO_IMAGE_KHR)
+    {
+      printf("eglCreateImageKHR failed.\n");
+      exit(1);
+    }
+    frame_cache_add_slot(&state->cache, tex, eglImage);
   }
+  #else
+  // without textures egl_render still needs a (null) buffer to render into
+  (void)slots;
+  frame_cache_add_slot(&state->cache, 0, 0);
   #endif
+  printf("Frame cache: %d slots, %zu MB\n", state->cache.count,
+         state->cache.count * state->cache.frameBytes / (1024 * 1024));
 
-  video->filename = filename;
-  video->eglImage = eglImage;
-  video->state = VIDEO_STATE_STOPPED;
-  video->command = VIDEO_COMMAND_PLAY;
-  pthread_create(&videoThread, NULL, video_decode_main, &video);
+  video_textures_ready(video);
 
   #ifdef ENABLE_TEXTURES
   // setup overall texture environment
@@ -319,11 +638,136 @@ static void init_textures(CUBE_STATE_T *state, char *filename)
   glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
   glEnable(GL_TEXTURE_2D);
+  #endif
+}
+
+/***********************************************************
+ * Name: init_deferred
+ *
+ * Arguments:
+ *       CUBE_STATE_T *state - holds OGLES model info
+ *
+ * Description:   Starts everything the first frame does not need, once
+ *                it is on screen, so it does not compete with start-up
+ *                for the CPU or the SD card
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void init_deferred(CUBE_STATE_T *state)
+{
+  state->deferredInit = 1;
+
+  // still image cues, advanced with SIGUSR1
+  stills_init(stills, stillCues, stillCueCount, 0, state->screen_width, state->screen_height,
+              STILLS_CACHE_BUDGET, upload_still, release_still, state);
+  printf("Stills initialized: %d cues, %d decode workers\n", stills->cueCount, stills->loader.workerCount);
 
+  char *overlayOption = getenv("PROJECTION_OVERLAY");
+  if (overlayOption != NULL && strcmp(overlayOption, "1") == 0)
+    init_overlay(state);
+}
+
+/***********************************************************
+ * Name: update_frame
+ *
+ * Arguments:
+ *       CUBE_STATE_T *state - holds OGLES model info
+ *       VIDEO_THREAD_DATA_T *video - video thread control
+ *
+ * Description:   Chooses which cached frame to show. Playback follows
+ *                the newest decoded frame; stepping and reverse look
+ *                frames up in the cache without the decoder; pause and
+ *                stop hold whatever is on screen. After a pause the
+ *                frame on screen is usually the newest decoded one, so
+ *                a forward step there has nothing to show: it is logged
+ *                and the player stays paused.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void update_frame(CUBE_STATE_T *state, VIDEO_THREAD_DATA_T *video)
+{
+  FRAME_CACHE_T *cache = &state->cache;
+  int slot = -1;
+
+  switch (video->command)
+  {
+    case VIDEO_COMMAND_PLAY:
+    case VIDEO_COMMAND_DEVAMP:
+      slot = frame_cache_newest(cache);
+      break;
+    case VIDEO_COMMAND_STEP_FORWARD:
+    case VIDEO_COMMAND_STEP_BACK: {
+      int forward = video->command == VIDEO_COMMAND_STEP_FORWARD;
+      slot = frame_cache_lookup(cache, state->frame + (forward ? 1 : -1));
+      if (slot < 0)
+        printf("Step %s: frame %ld is not cached, holding frame %ld\n",
+               forward ? "forward" : "back", state->frame + (forward ? 1 : -1), state->frame);
+      video->command = VIDEO_COMMAND_PAUSE;
+      break;
+    }
+    case VIDEO_COMMAND_REVERSE:
+      if (seconds() - state->frameSeconds >= frame_cache_frame_period(cache)) {
+        slot = frame_cache_lookup(cache, state->frame - 1);
+        // reached the oldest cached frame: hold it, as a step does
+        if (slot < 0)
+          video->command = VIDEO_COMMAND_PAUSE;
+      }
+      break;
+    default:
+      // hold the last frame
+      break;
+  }
+
+  if (video->command != VIDEO_COMMAND_PLAY)
+    state->syncSeconds = 0;
+  if (slot < 0 || slot == state->slot)
+    return;
+
+  long frame = frame_cache_frame(cache, slot);
+  if (video->command == VIDEO_COMMAND_PLAY) {
+    if (state->syncSeconds == 0) {
+      state->syncFrame = frame;
+      state->syncSeconds = seconds();
+    }
+    else if (frame > state->frame + 1)
+      state->droppedFrames += frame - state->frame - 1;
+  }
+
+  frame_cache_pin(cache, slot);
+  state->slot = slot;
+  state->frame = frame;
+  state->frameSeconds = seconds();
+
+  #ifdef ENABLE_TEXTURES
   // Bind texture surface to current vertices
-  glBindTexture(GL_TEXTURE_2D, state->tex);
+  glBindTexture(GL_TEXTURE_2D, cache->slots[slot].tex);
   #endif
 }
+
+static void print_frame_cache_stats(CUBE_STATE_T *state)
+{
+  FRAME_CACHE_STATS_T stats;
+  frame_cache_get_stats(&state->cache, &stats);
+
+  unsigned long lookups = stats.hits + stats.misses;
+  printf("Frame cache: %d/%d frames, %zu/%zu bytes, %lu hits, %lu misses (%.1f%%), %lu evictions\n",
+         stats.filled, stats.slots, stats.bytesFilled, stats.bytesAllocated,
+         stats.hits, stats.misses, lookups ? 100.0 * stats.hits / lookups : 0.0, stats.evictions);
+}
+
+static void print_watchdog_stats(VIDEO_THREAD_DATA_T *video)
+{
+  WATCHDOG_STATS_T stats;
+  watchdog_get_stats(&video->watchdog, &stats);
+
+  if (stats.stalls == 0 && stats.abandoned == 0)
+    return;
+  printf("Decoder watchdog: %lu stalls (last: %s), %lu recoveries, last %.3fs, worst %.3fs, %lu teardowns abandoned\n",
+         stats.stalls, watchdog_reason(stats.lastReason), stats.recoveries,
+         stats.lastRecoverySeconds, stats.worstRecoverySeconds, stats.abandoned);
+}
 //------------------------------------------------------------------------------
 
 static void exit_func(void)
@@ -331,11 +775,39 @@ static void exit_func(void)
 {
   
   printf("\nCLEAN UP\n");
-  if (eglImage != 0)
+  print_frame_cache_stats(state);
+  print_watchdog_stats(video);
+  if (state->deferredInit)
+  {
+    print_stills_stats(stills);
+    stills_destroy(stills);
+  }
+  if (overlayEnabled)
+  {
+    printf("Overlay: %lu layouts, %lu strings reused\n", overlay->layouts, overlay->reuses);
+    glDeleteTextures(1, &overlayTex);
+    text_layer_destroy(overlay);
+  }
+  if (show != NULL)
+  {
+    show_unload(show);
+    free(stillCues);
+    free(showVideoPath);
+  }
+
+  int i;
+  for (i = 0; i < state->cache.count; i++)
   {
-    if (!eglDestroyImageKHR(state->display, (EGLImageKHR) eglImage))
-      printf("eglDestroyImageKHR failed.");
+    FRAME_CACHE_SLOT_T *slot = &state->cache.slots[i];
+    if (slot->eglImage != 0)
+    {
+      if (!eglDestroyImageKHR(state->display, (EGLImageKHR) slot->eglImage))
+        printf("eglDestroyImageKHR failed.");
+    }
+    if (slot->tex != 0)
+      glDeleteTextures(1, &slot->tex);
   }
+  frame_cache_destroy(&state->cache);
 
   // clear screen
   glClear( GL_COLOR_BUFFER_BIT );
@@ -377,27 +849,122 @@ static double seconds() {
 }
 
 static void update_fade(CUBE_STATE_T *state, FADE_DATA_T *fade) {
-  if (fade < 0 || fade->speed < 0)
+  state->alpha = fade_update(fade, state->alpha, seconds());
+}
+
+/***********************************************************
+ * Name: open_show
+ *
+ * Arguments:
+ *       char *path - command line file, a compiled show or a video
+ *
+ * Description:   If path is a compiled show, loads it and takes the
+ *                still cues from it
+ *
+ * Returns: char * - video to play, path itself if it is not a show
+ *
+ ***********************************************************/
+static char *open_show(char *path)
+{
+  int status = show_load(&shows[0], path);
+
+  if (status == SHOW_ERROR_NOT_SHOW || status == SHOW_ERROR_OPEN)
+    return path;
+  if (status != 0) {
+    printf("Could not load show %s: %s\n", path, show_error(status));
+    exit(1);
+  }
+
+  show = &shows[0];
+  showPath = path;
+  // the video is the first cue's clip; clip changes during the show are not played yet
+  if ((showVideoPath = show_video_path(show)) == NULL) {
+    printf("Show %s has no clips\n", path);
+    exit(1);
+  }
+
+  stillCueCount = show_cue_count(show);
+  stillCues = malloc(stillCueCount * sizeof(char *));
+  int i;
+  for (i = 0; i < stillCueCount; i++)
+    stillCues[i] = (char *)show_string(show, show_cue(show, i)->still);
+  printf("Show %s loaded: %d cues\n", path, stillCueCount);
+  return showVideoPath;
+}
+
+/***********************************************************
+ * Name: reload_show
+ *
+ * Arguments:
+ *       void
+ *
+ * Description:   Loads the show file again into the spare slot and, only
+ *                if that works, swaps it in. Called between frames, so
+ *                nothing sees a mix of the old and new show. The current
+ *                cue is kept by index.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void reload_show(void)
+{
+  SHOW_T *next = show == &shows[0] ? &shows[1] : &shows[0];
+  double start = seconds();
+  char **cues;
+  int status, count, i;
+
+  if (show == NULL)
+    return;
+  if ((status = show_load(next, showPath)) != 0) {
+    printf("Could not reload show %s: %s, keeping the old one\n", showPath, show_error(status));
     return;
-  // dir > 1 iff alpha is increasing
-  int dir = 1;
-  if (fade->target < fade->startAlpha)
-    dir = -1;
-
-  double timeDiff = seconds() - fade->startSeconds;
-  // delta = magnitude of change since start
-  float delta = timeDiff * fade->speed;
-  // alpha = alpha' * delta * dir
-  float alpha = fade->startAlpha + (delta * dir);
-  if ((dir > 0 && alpha > fade->target) || (dir < 0 && alpha < fade->target)) {
-    printf("Finished fade to %f\n", fade->target);
-    state->alpha = fade->target;
-    fade->speed = -1;
-  } else {
-    state->alpha = alpha;
   }
+  count = show_cue_count(next);
+  if ((cues = malloc(count * sizeof(char *))) == NULL) {
+    show_unload(next);
+    return;
+  }
+  for (i = 0; i < count; i++)
+    cues[i] = (char *)show_string(next, show_cue(next, i)->still);
+
+  if (state->deferredInit)
+    stills_set_cues(stills, cues, count);
+  free(stillCues);
+  show_unload(show);
+  show = next;
+  stillCues = cues;
+  stillCueCount = count;
+  printf("Reloaded show %s: %d cues in %.3f ms\n", showPath, count, (seconds() - start) * 1000);
+}
+
+// Goes to a cue: its still, and for a show, a fade to its alpha.
+static void go_to_cue(int cue)
+{
+  const SHOW_CUE_T *c;
+
+  stills_go(stills, cue);
+  if (show == NULL || (c = show_cue(show, cue)) == NULL)
+    return;
+  float speed = c->fadeSeconds > 0 ? fabsf(c->alpha - state->alpha) / c->fadeSeconds : INSTANT_FADE_SPEED;
+  fade_start(fade, c->alpha, speed, state->alpha, seconds());
+  trace_record(TRACE_FADE, (int32_t)(fade->target * 1000000), (int32_t)(fade->speed * 1000000));
 }
+
 void sig_handler(int signo) {
+  if (signo == SIGUSR1) {
+    // the handler can run on any thread, so count with the same atomics the
+    // render loop takes the presses with
+    __atomic_add_fetch(&nextCue, 1, __ATOMIC_SEQ_CST);
+    return;
+  }
+  if (signo == SIGHUP) {
+    reloadShow = 1;
+    return;
+  }
+  if (signo >= SIGRTMIN && signo < SIGRTMIN + TRANSPORT_SIGNALS) {
+    requestedCommand = transportCommands[signo - SIGRTMIN];
+    return;
+  }
   terminate = 1;
   signal(SIGINT, SIG_DFL);
 }
@@ -405,38 +972,96 @@ void sig_handler(int signo) {
 int main (int argc, char **argv)
 {
   if (argc < 2) {
-    printf("Usage: %s <filename>\n", argv[0]);
+    printf("Usage: %s <filename> [image ...]\n", argv[0]);
+    printf("       %s <show>\n", argv[0]);
+    printf("SIGUSR1: next cue, SIGHUP: reload show\n");
+    printf("SIGRTMIN+0..4: play, pause, step forward, step back, reverse\n");
     exit(1);
   }
 
+  startup_begin();
+
+  char *tracePath = getenv("PROJECTION_TRACE");
+  if (tracePath != NULL && trace_open(tracePath) != 0)
+    printf("Could not open trace file %s\n", tracePath);
+
+  startup_phase_begin(STARTUP_PHASE_BCM_HOST);
   bcm_host_init();
+  startup_phase_end(STARTUP_PHASE_BCM_HOST);
   printf("Note: ensure you have sufficient gpu_mem configured\n");
 
   // Clear application state
   memset( state, 0, sizeof( *state ) );
   printf("State memory allocated\n");
+
+  // a compiled show names the video and the still cues itself
+  char *videoPath = open_show(argv[1]);
+  if (show == NULL) {
+    stillCues = argv + 2;
+    stillCueCount = argc - 2;
+  }
+
+  // Decoder set-up and file open run while the display comes up
+  start_video(state, videoPath);
   
   // Start OGLES
+  startup_phase_begin(STARTUP_PHASE_EGL);
   init_ogl(state);
+  startup_phase_end(STARTUP_PHASE_EGL);
   printf("OpenGL ES initialized\n");
 
   // initialise the OGLES texture(s)
-  init_textures(state, argv[1]);
+  startup_phase_begin(STARTUP_PHASE_TEXTURES);
+  init_textures(state);
+  startup_phase_end(STARTUP_PHASE_TEXTURES);
   printf("Textures Initialized\n");
 
-  fade->target = 0.0f;
-  fade->speed = 0.1f;
-  fade->startSeconds = seconds();
-  fade->startAlpha = state->alpha;
+  fade_start(fade, 0.0f, 0.1f, state->alpha, seconds());
+  trace_record(TRACE_FADE, (int32_t)(fade->target * 1000000), (int32_t)(fade->speed * 1000000));
 
   signal(SIGINT, sig_handler);
+  signal(SIGUSR1, sig_handler);
+  signal(SIGHUP, sig_handler);
+  int i;
+  for (i = 0; i < TRANSPORT_SIGNALS; i++)
+    signal(SIGRTMIN + i, sig_handler);
 
   printf("\nStarting render loop\n");
+  double loopStart = seconds();
   while (!terminate)
   {
+    if (reloadShow) {
+      reloadShow = 0;
+      reload_show();
+    }
+
+    int command = __atomic_exchange_n(&requestedCommand, VIDEO_COMMAND_NULL, __ATOMIC_SEQ_CST);
+    if (command != VIDEO_COMMAND_NULL && video->command != VIDEO_COMMAND_TERMINATE)
+      video->command = command;
+
     update_fade(state, fade);
 
+    update_frame(state, video);
+    trace_record(TRACE_FRAME, state->frame, (int32_t)(state->alpha * 1000000));
+
+    if (state->deferredInit) {
+      // every press since the last frame, none lost to a signal in between
+      int advance = __atomic_exchange_n(&nextCue, 0, __ATOMIC_SEQ_CST);
+      if (advance > 0)
+        go_to_cue(stills->current + advance);
+      stills_update(stills);
+    }
+
+    update_overlay(state);
     redraw_scene(state);
+
+    if (state->slot >= 0 && !startup_done(STARTUP_PHASE_FIRST_FRAME_SHOWN)) {
+      startup_mark(STARTUP_PHASE_FIRST_FRAME_SHOWN);
+      startup_report();
+    }
+    if (!state->deferredInit &&
+        (state->slot >= 0 || seconds() - loopStart > DEFERRED_INIT_TIMEOUT))
+      init_deferred(state);
   }
   printf("Finished render loop\n");
 
@@ -444,6 +1069,7 @@ int main (int argc, char **argv)
 
   printf("Video thread terminated\n");
   exit_func();
+  trace_close();
   printf("Clean-up finished\n");
   return 0;
 }
\ No newline at end of file
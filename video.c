@@ -31,6 +31,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #include "bcm_host.h"
 #include "ilclient.h"
@@ -38,65 +41,505 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef VIDEO_H
 	#include "video.h"
 #endif
+#include "startup.h"
+#include "trace.h"
+
+// how much of the file to ask the kernel to read ahead while OMX starts up
+#define PREFETCH_BYTES (8 * 1024 * 1024)
+
+// deadlines for the decoder to take an input buffer and to fill a frame
+#define WATCHDOG_INPUT_SECONDS 3.0
+#define WATCHDOG_OUTPUT_SECONDS 2.0
+// how long to wait for a pipeline to come down before abandoning it
+#define WATCHDOG_TEARDOWN_SECONDS 2.0
+// restarts in a row without a frame before giving up
+#define MAX_RESTARTS 5
+// how long each wait for the decoder lasts before checking the watchdog
+#define INPUT_POLL_NANOS 5000000L
+#define EVENT_POLL_MILLIS 100
+#define KEYFRAME_HISTORY 16
+
+#define NAL_SLICE 1
+#define NAL_IDR_SLICE 5
+#define NAL_SPS 7
+
+// returned by video_decode when the watchdog fired
+#define STATUS_STALLED -30
+
+typedef struct
+{
+	char *filename;
+	FILE *in;
+	pthread_t thread;
+	int started;
+} PREFETCH_T;
+
+typedef struct
+{
+	long long offset;
+	long picture;
+} KEYFRAME_T;
+
+// One decode pipeline, on the heap so that its teardown can be left
+// running on its own thread if a wedged component never answers. Whoever
+// finishes last, the teardown thread or the decode thread, frees it.
+typedef struct
+{
+	ILCLIENT_T *client;
+	COMPONENT_T *list[5];
+	TUNNEL_T tunnel[4];
+	COMPONENT_T *decoder;
+	// input port buffers were enabled and must be flushed and disabled
+	int portBuffers;
+	int done;
+	int abandoned;
+	pthread_mutex_t lock;
+	pthread_cond_t finished;
+} PIPELINE_T;
+
+// Where the decoder has got to in the stream, so a restarted pipeline can
+// pick it up from the last SPS before the frame on screen. Pictures are
+// counted from slice headers as they are fed and frames as egl_render
+// fills them; both keep counting across rewinds and restarts.
+typedef struct
+{
+	// bytes fed from the current pass through the file
+	long long offset;
+	long pictures;
+	long decoded;
+	// frames the new pipeline decodes again that were already shown
+	long skip;
+	KEYFRAME_T keyframes[KEYFRAME_HISTORY];
+	int keyframeCount;
+	// start code scanner, carried across buffers
+	int zeros;
+	int nalHeader;
+	int sliceHeader;
+	long long nalStart;
+} STREAM_POSITION_T;
 
 
 static int video_decode(VIDEO_THREAD_DATA_T *video);
 
+static int is_paused(int command);
 static void pause_if_necessary(VIDEO_THREAD_DATA_T *video);
 static void devamp_if_necessary(VIDEO_THREAD_DATA_T *video, FILE *in);
+static int use_frame_cache(VIDEO_THREAD_DATA_T *video);
+static int fill_next_frame(VIDEO_THREAD_DATA_T *video);
+static void fill_if_playing(VIDEO_THREAD_DATA_T *video);
+static double seconds();
+static void start_prefetch(PREFETCH_T *prefetch, char *filename);
+static FILE *finish_prefetch(PREFETCH_T *prefetch);
+static void wait_for_textures(VIDEO_THREAD_DATA_T *video);
+static void trace_command(VIDEO_THREAD_DATA_T *video);
+static OMX_BUFFERHEADERTYPE *next_input_buffer(VIDEO_THREAD_DATA_T *video, COMPONENT_T *decoder);
+static int wait_for_port_settings(VIDEO_THREAD_DATA_T *video, COMPONENT_T *decoder);
+static void rewind_position(STREAM_POSITION_T *position);
+static void scan_fed_data(STREAM_POSITION_T *position, const unsigned char *data, unsigned int len);
+static void resume_from_keyframe(STREAM_POSITION_T *position);
+static PIPELINE_T *new_pipeline(void);
+static void free_pipeline(PIPELINE_T *pipeline);
+static void *teardown_main(void *arg);
+static void teardown_pipeline(VIDEO_THREAD_DATA_T *video, PIPELINE_T *pipeline);
 
-static OMX_BUFFERHEADERTYPE* eglBuffer = NULL;
 static COMPONENT_T* egl_render = NULL;
 
 static VIDEO_THREAD_DATA_T *video;
 
+// input buffers handed to video_decode so far, the trace's sense of time
+static int buffersFed;
+static int tracedCommand;
+
+static STREAM_POSITION_T position;
+// set while egl_render has the frame cache buffers
+static volatile int outputRunning;
+// frames shown from the current pipeline
+static int pipelineFrames;
+// egl_render is owed a buffer, held back while the renderer is paused
+static int fillPending;
+
 void my_fill_buffer_done(void* data, COMPONENT_T* comp)
 {
-  if (OMX_FillThisBuffer(ilclient_get_handle(egl_render), eglBuffer) != OMX_ErrorNone)
+	OMX_BUFFERHEADERTYPE *filled;
+
+	// a pipeline being torn down, or abandoned, has nothing for the cache
+	if (comp != egl_render)
+		return;
+
+	// hand every decoded frame to the cache, then give egl_render the next slot
+	while ((filled = ilclient_get_output_buffer(egl_render, 221, 0)) != NULL)
 	{
-		printf("OMX_FillThisBuffer failed in callback\n");
-		exit(1);
+		int slot = frame_cache_find_buffer(video->cache, filled);
+		if (slot < 0)
+			continue;
+
+		position.decoded++;
+		if (position.skip > 0)
+		{
+			// already shown before the restart
+			position.skip--;
+			frame_cache_discard(video->cache, slot);
+			continue;
+		}
+
+		long frame = frame_cache_complete(video->cache, slot, seconds());
+		if (frame == 0)
+			startup_mark(STARTUP_PHASE_FIRST_FRAME_DECODED);
+		trace_record(TRACE_DECODED, frame, buffersFed);
+		pipelineFrames++;
+		watchdog_output(&video->watchdog);
 	}
+
+	__atomic_store_n(&fillPending, 1, __ATOMIC_SEQ_CST);
+	fill_if_playing(video);
 }
 
+static double seconds() {
+	struct timespec t;
+	clock_gettime(CLOCK_REALTIME, &t);
+	return (double)t.tv_nsec / 1000000000 + (double)t.tv_sec;
+}
+
+
+/***********************************************************
+ * Name: video_init
+ *
+ * Arguments:
+ *       VIDEO_THREAD_DATA_T *video - thread data to set up
+ *       char *filename - H.264 elementary stream to play
+ *       FRAME_CACHE_T *cache - cache the decoder renders into
+ *
+ * Description:   Prepares the thread data so the video thread can be
+ *                started before the renderer has made its textures. The
+ *                thread creates the OMX components and starts feeding
+ *                data straight away, then waits in wait_for_textures()
+ *                until video_textures_ready() is called.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void video_init(VIDEO_THREAD_DATA_T *video, char *filename, FRAME_CACHE_T *cache)
+{
+	video->filename = filename;
+	video->cache = cache;
+	video->state = VIDEO_STATE_STOPPED;
+	video->command = VIDEO_COMMAND_PLAY;
+	video->texturesReady = 0;
+	video->idle = NULL;
+	watchdog_init(&video->watchdog, WATCHDOG_INPUT_SECONDS, WATCHDOG_OUTPUT_SECONDS, WATCHDOG_TEARDOWN_SECONDS);
+	pthread_mutex_init(&video->lock, NULL);
+	pthread_cond_init(&video->texturesCond, NULL);
+}
+
+void video_textures_ready(VIDEO_THREAD_DATA_T *video)
+{
+	pthread_mutex_lock(&video->lock);
+	video->texturesReady = 1;
+	pthread_cond_broadcast(&video->texturesCond);
+	pthread_mutex_unlock(&video->lock);
+}
+
+static void wait_for_textures(VIDEO_THREAD_DATA_T *video)
+{
+	pthread_mutex_lock(&video->lock);
+	while (!video->texturesReady)
+		pthread_cond_wait(&video->texturesCond, &video->lock);
+	pthread_mutex_unlock(&video->lock);
+}
+
+static void *prefetch_main(void *arg)
+{
+	PREFETCH_T *prefetch = arg;
+
+	startup_phase_begin(STARTUP_PHASE_FILE_PREFETCH);
+	prefetch->in = fopen(prefetch->filename, "rb");
+	if (prefetch->in != NULL)
+	{
+		int fd = fileno(prefetch->in);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		posix_fadvise(fd, 0, PREFETCH_BYTES, POSIX_FADV_WILLNEED);
+	}
+	startup_phase_end(STARTUP_PHASE_FILE_PREFETCH);
+	return NULL;
+}
+
+// Opens the file and starts read-ahead on another thread, as the first
+// open after boot can block on the SD card for a while.
+static void start_prefetch(PREFETCH_T *prefetch, char *filename)
+{
+	memset(prefetch, 0, sizeof(*prefetch));
+	prefetch->filename = filename;
+	if (pthread_create(&prefetch->thread, NULL, prefetch_main, prefetch) == 0)
+		prefetch->started = 1;
+	else
+		prefetch_main(prefetch);
+}
+
+static FILE *finish_prefetch(PREFETCH_T *prefetch)
+{
+	if (prefetch->started)
+		pthread_join(prefetch->thread, NULL);
+	prefetch->started = 0;
+	return prefetch->in;
+}
 
 // Modified function prototype to work with pthreads
 void *video_decode_main(void *arg)
 {
 	printf("pV: video_decode_test start\n");
-	video->state = VIDEO_STATE_STOPPED;
-
 	video = arg;
+	video->state = VIDEO_STATE_STOPPED;
 
 	printf("pV: %s\n", video->filename);
 
-	int code = video_decode(video);
+	memset(&position, 0, sizeof(position));
+	buffersFed = 0;
+	tracedCommand = VIDEO_COMMAND_NULL;
+	watchdog_start(&video->watchdog);
+
+	// the renderer holds the last frame from the cache while a stalled
+	// pipeline is torn down and rebuilt
+	int code, restarts = 0;
+	while ((code = video_decode(video)) == STATUS_STALLED && video->command != VIDEO_COMMAND_TERMINATE)
+	{
+		restarts = pipelineFrames > 0 ? 1 : restarts + 1;
+		if (restarts > MAX_RESTARTS)
+		{
+			printf("pV: decoder still stalled after %d restarts\n", MAX_RESTARTS);
+			break;
+		}
+		trace_record(TRACE_RESTART, watchdog_fired(&video->watchdog), buffersFed);
+		resume_from_keyframe(&position);
+		watchdog_restarted(&video->watchdog);
+		printf("pV: restarting decoder at byte %lld\n", position.offset);
+	}
+
+	watchdog_stop(&video->watchdog);
 	video->state = VIDEO_STATE_TERMINATED;
 	printf("pV: terminating with code %d\n", code);
 	return (void*) code;
 }
 
+// Frame stepping and reverse playback are served by the renderer from the
+// frame cache, so the decoder holds still for them exactly as for a pause.
+static int is_paused(int command) {
+	return command == VIDEO_COMMAND_PAUSE ||
+		command == VIDEO_COMMAND_STEP_FORWARD ||
+		command == VIDEO_COMMAND_STEP_BACK ||
+		command == VIDEO_COMMAND_REVERSE;
+}
+
 static void pause_if_necessary(VIDEO_THREAD_DATA_T *video) {
-	if (video->command == VIDEO_COMMAND_PAUSE) {
+	if (is_paused(video->command)) {
 		video->state = VIDEO_STATE_PAUSED;
+		watchdog_arm_input(&video->watchdog, 0);
+		watchdog_arm_output(&video->watchdog, 0);
 		struct timespec timInterval, timRemainder;
 		timInterval.tv_sec = 0;
 		timInterval.tv_nsec = 50000000L;
-		while (video->command == VIDEO_COMMAND_PAUSE) {
-			nanosleep(&timInterval, &timRemainder);
+		while (is_paused(video->command)) {
+			if (video->idle != NULL)
+				video->idle(video);
+			else
+				nanosleep(&timInterval, &timRemainder);
 		}
+		trace_command(video);
+		watchdog_arm_input(&video->watchdog, 1);
+		watchdog_arm_output(&video->watchdog, outputRunning);
+		fill_if_playing(video);
+	}
+}
+
+// Commands are traced when the decoder acts on them, against the number of
+// buffers fed, so a replay can apply them at the same point in the stream.
+static void trace_command(VIDEO_THREAD_DATA_T *video) {
+	int command = video->command;
+	if (command != tracedCommand) {
+		tracedCommand = command;
+		trace_record(TRACE_COMMAND, command, buffersFed);
 	}
 }
 
 static void devamp_if_necessary(VIDEO_THREAD_DATA_T *video, FILE *in) {
 	if (feof(in)) {
-		if (video->command == VIDEO_COMMAND_DEVAMP)
+		if (video->command == VIDEO_COMMAND_DEVAMP) {
 			video->command = VIDEO_COMMAND_STOP;
-		else
+			trace_command(video);
+		} else {
 			rewind(in);
+			rewind_position(&position);
+			trace_record(TRACE_REWIND, 0, buffersFed);
+		}
 	}
 }
 
+// Registers every frame cache slot as an egl_render output buffer.
+static int use_frame_cache(VIDEO_THREAD_DATA_T *video) {
+	FRAME_CACHE_T *cache = video->cache;
+	OMX_PARAM_PORTDEFINITIONTYPE portdef;
+	int i;
+
+	memset(&portdef, 0, sizeof(portdef));
+	portdef.nSize = sizeof(portdef);
+	portdef.nVersion.nVersion = OMX_VERSION;
+	portdef.nPortIndex = 221;
+	if (OMX_GetParameter(ILC_GET_HANDLE(egl_render), OMX_IndexParamPortDefinition, &portdef) != OMX_ErrorNone)
+		return -1;
+	portdef.nBufferCountActual = cache->count;
+	if (OMX_SetParameter(ILC_GET_HANDLE(egl_render), OMX_IndexParamPortDefinition, &portdef) != OMX_ErrorNone)
+		return -1;
+
+	//ilclient_enable_port(egl_render, 221); THIS BLOCKS SO CANT BE USED
+	if (OMX_SendCommand(ILC_GET_HANDLE(egl_render), OMX_CommandPortEnable, 221, NULL) != OMX_ErrorNone)
+		return -1;
+
+	for (i = 0; i < cache->count; i++) {
+		OMX_BUFFERHEADERTYPE *buffer = NULL;
+		if (OMX_UseEGLImage(ILC_GET_HANDLE(egl_render), &buffer, 221, NULL, cache->slots[i].eglImage) != OMX_ErrorNone)
+			return -1;
+		frame_cache_attach_buffer(cache, i, buffer);
+	}
+	return 0;
+}
+
+static int fill_next_frame(VIDEO_THREAD_DATA_T *video) {
+	int slot = frame_cache_acquire(video->cache, seconds());
+	if (slot < 0)
+		return -1;
+	return OMX_FillThisBuffer(ILC_GET_HANDLE(egl_render), video->cache->slots[slot].buffer) == OMX_ErrorNone ? 0 : -1;
+}
+
+// Gives egl_render its next buffer unless the renderer is paused, stepping
+// or reversing. Those are served from the cache, and every frame decoded
+// meanwhile would evict a frame of the history they depend on. Called by
+// the fill callback and when playback resumes; whichever runs second
+// issues the fill.
+static void fill_if_playing(VIDEO_THREAD_DATA_T *video) {
+	if (!outputRunning || is_paused(video->command))
+		return;
+	// the decode thread restarts the pipeline rather than the process exiting
+	if (__atomic_exchange_n(&fillPending, 0, __ATOMIC_SEQ_CST) && fill_next_frame(video) != 0)
+	{
+		printf("OMX_FillThisBuffer failed\n");
+		watchdog_fail(&video->watchdog, WATCHDOG_FILL_FAILED);
+	}
+}
+
+// Waits for the decoder to hand back an input buffer a slice at a time,
+// giving up if the watchdog fires or the player is closing.
+static OMX_BUFFERHEADERTYPE *next_input_buffer(VIDEO_THREAD_DATA_T *video, COMPONENT_T *decoder) {
+	OMX_BUFFERHEADERTYPE *buf;
+	struct timespec timInterval, timRemainder;
+	timInterval.tv_sec = 0;
+	timInterval.tv_nsec = INPUT_POLL_NANOS;
+
+	while (watchdog_fired(&video->watchdog) == WATCHDOG_NONE) {
+		// with fills held back a paused decoder backs up and keeps its input
+		// buffer, so the pause is served here and not taken for a stall
+		if (is_paused(video->command)) {
+			trace_command(video);
+			pause_if_necessary(video);
+		}
+		if ((buf = ilclient_get_input_buffer(decoder, 130, 0)) != NULL) {
+			watchdog_input(&video->watchdog);
+			return buf;
+		}
+		if (video->command == VIDEO_COMMAND_TERMINATE)
+			break;
+		nanosleep(&timInterval, &timRemainder);
+	}
+	return NULL;
+}
+
+// The whole file has been fed without the decoder reporting its output
+// format. Waits in short slices until it does or the watchdog fires.
+static int wait_for_port_settings(VIDEO_THREAD_DATA_T *video, COMPONENT_T *decoder) {
+	while (watchdog_fired(&video->watchdog) == WATCHDOG_NONE && video->command != VIDEO_COMMAND_TERMINATE) {
+		if (ilclient_wait_for_event(decoder, OMX_EventPortSettingsChanged, 131, 0, 0, 1,
+				ILCLIENT_EVENT_ERROR | ILCLIENT_PARAMETER_CHANGED, EVENT_POLL_MILLIS) == 0)
+			return 0;
+	}
+	return -1;
+}
+
+static void rewind_position(STREAM_POSITION_T *position) {
+	position->offset = 0;
+	position->zeros = 0;
+	position->nalHeader = 0;
+	position->sliceHeader = 0;
+}
+
+/***********************************************************
+ * Name: scan_fed_data
+ *
+ * Arguments:
+ *       STREAM_POSITION_T *position - stream position to advance
+ *       const unsigned char *data - bytes the decoder has just taken
+ *       unsigned int len - number of bytes
+ *
+ * Description:   Looks for NAL start codes in the H.264 elementary stream.
+ *                A slice whose first_mb_in_slice is 0 starts a picture
+ *                and an SPS is somewhere a new decoder can start from.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void scan_fed_data(STREAM_POSITION_T *position, const unsigned char *data, unsigned int len) {
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		unsigned char b = data[i];
+
+		if (position->sliceHeader) {
+			// first_mb_in_slice is ue(v), which is 0 when the first bit is set
+			if (b & 0x80)
+				position->pictures++;
+			position->sliceHeader = 0;
+		} else if (position->nalHeader) {
+			int type = b & 0x1f;
+			if (type == NAL_SPS) {
+				KEYFRAME_T *keyframe = &position->keyframes[position->keyframeCount++ % KEYFRAME_HISTORY];
+				keyframe->offset = position->nalStart;
+				keyframe->picture = position->pictures;
+			} else if (type == NAL_SLICE || type == NAL_IDR_SLICE)
+				position->sliceHeader = 1;
+			position->nalHeader = 0;
+		}
+
+		if (b == 1 && position->zeros >= 2) {
+			position->nalHeader = 1;
+			position->nalStart = position->offset + i - (position->zeros > 3 ? 3 : position->zeros);
+		}
+		position->zeros = b == 0 ? position->zeros + 1 : 0;
+	}
+	position->offset += len;
+}
+
+// Chooses where the next pipeline starts: the newest SPS at or before the
+// last frame decoded, or the start of the file if there is none. Frames
+// between there and the last one decoded are decoded again but not shown.
+static void resume_from_keyframe(STREAM_POSITION_T *position) {
+	KEYFRAME_T resume = { 0, position->decoded };
+	int oldest = position->keyframeCount > KEYFRAME_HISTORY ? position->keyframeCount - KEYFRAME_HISTORY : 0;
+	int i;
+
+	for (i = position->keyframeCount - 1; i >= oldest; i--) {
+		KEYFRAME_T *keyframe = &position->keyframes[i % KEYFRAME_HISTORY];
+		if (keyframe->picture <= position->decoded) {
+			resume = *keyframe;
+			break;
+		}
+	}
+	// the resume point and anything after it are seen again as they are fed
+	position->keyframeCount = i >= oldest ? i : oldest;
+
+	rewind_position(position);
+	position->offset = resume.offset;
+	position->pictures = resume.picture;
+	position->skip = position->decoded - resume.picture;
+	position->decoded = resume.picture;
+}
+
 static void setupClockState(OMX_TIME_CONFIG_CLOCKSTATETYPE cstate) {
 	cstate.nSize = sizeof(cstate);
 	cstate.nVersion.nVersion = OMX_VERSION;
@@ -111,33 +554,154 @@ static void setupVideoFormat(OMX_VIDEO_PARAM_PORTFORMATTYPE format) {
 	format.eCompressionFormat = OMX_VIDEO_CodingAVC;
 }
 	
+static PIPELINE_T *new_pipeline(void) {
+	PIPELINE_T *pipeline = calloc(1, sizeof(*pipeline));
+	pthread_condattr_t attr;
+
+	if (pipeline == NULL)
+		return NULL;
+	pthread_mutex_init(&pipeline->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&pipeline->finished, &attr);
+	pthread_condattr_destroy(&attr);
+	return pipeline;
+}
+
+static void free_pipeline(PIPELINE_T *pipeline) {
+	pthread_mutex_destroy(&pipeline->lock);
+	pthread_cond_destroy(&pipeline->finished);
+	free(pipeline);
+}
+
+// Every step here waits on the components, and a wedged one may never
+// answer, so it runs on a thread of its own.
+static void *teardown_main(void *arg) {
+	PIPELINE_T *pipeline = arg;
+	int abandoned;
+
+	if (pipeline->portBuffers) {
+		// need to flush the renderer to allow video_decode to disable its input port
+		ilclient_flush_tunnels(pipeline->tunnel, 0);
+
+		ilclient_disable_port_buffers(pipeline->decoder, 130, NULL, NULL, NULL);
+	}
+
+	ilclient_disable_tunnel(pipeline->tunnel);
+	ilclient_disable_tunnel(pipeline->tunnel+1);
+	ilclient_disable_tunnel(pipeline->tunnel+2);
+	ilclient_teardown_tunnels(pipeline->tunnel);
+
+	ilclient_state_transition(pipeline->list, OMX_StateIdle);
+	ilclient_state_transition(pipeline->list, OMX_StateLoaded);
+
+	ilclient_cleanup_components(pipeline->list);
+
+	OMX_Deinit();
+
+	ilclient_destroy(pipeline->client);
+
+	pthread_mutex_lock(&pipeline->lock);
+	pipeline->done = 1;
+	abandoned = pipeline->abandoned;
+	pthread_cond_signal(&pipeline->finished);
+	pthread_mutex_unlock(&pipeline->lock);
+	if (abandoned)
+		free_pipeline(pipeline);
+	return NULL;
+}
+
+/***********************************************************
+ * Name: teardown_pipeline
+ *
+ * Arguments:
+ *       VIDEO_THREAD_DATA_T *video - video thread data
+ *       PIPELINE_T *pipeline - pipeline to take down
+ *
+ * Description:   Tears a pipeline down on another thread and waits up to
+ *                the watchdog's teardown timeout for it. If it does not
+ *                finish the pipeline is abandoned with its thread still
+ *                blocked, to be freed if it ever returns, and the caller
+ *                carries on to build a fresh one with a new ilclient.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+static void teardown_pipeline(VIDEO_THREAD_DATA_T *video, PIPELINE_T *pipeline) {
+	struct timespec until;
+	pthread_t thread;
+	double timeout = video->watchdog.teardownTimeout;
+
+	// callbacks from the old egl_render are ignored from here on
+	egl_render = NULL;
+
+	if (pthread_create(&thread, NULL, teardown_main, pipeline) != 0) {
+		teardown_main(pipeline);
+		free_pipeline(pipeline);
+		return;
+	}
+	pthread_detach(thread);
+
+	clock_gettime(CLOCK_MONOTONIC, &until);
+	until.tv_sec += (time_t)timeout;
+	until.tv_nsec += (long)((timeout - (time_t)timeout) * 1000000000);
+	if (until.tv_nsec >= 1000000000L) {
+		until.tv_sec++;
+		until.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&pipeline->lock);
+	while (!pipeline->done && pthread_cond_timedwait(&pipeline->finished, &pipeline->lock, &until) == 0)
+		;
+	if (!pipeline->done) {
+		pipeline->abandoned = 1;
+		pthread_mutex_unlock(&pipeline->lock);
+		watchdog_abandoned(&video->watchdog);
+		return;
+	}
+	pthread_mutex_unlock(&pipeline->lock);
+	free_pipeline(pipeline);
+}
+
 static int video_decode(VIDEO_THREAD_DATA_T *video) {
-	COMPONENT_T *list[5];
-	TUNNEL_T tunnel[4];
+	PIPELINE_T *pipeline;
+	COMPONENT_T **list;
+	TUNNEL_T *tunnel;
 	ILCLIENT_T *client;
+	PREFETCH_T prefetch;
 	FILE *in;
 
 	int status = 0;
 	unsigned int data_len = 0;
 
-	memset(list, 0, sizeof(list));
-	memset(tunnel, 0, sizeof(tunnel));
+	if((pipeline = new_pipeline()) == NULL)
+		return -3;
+	list = pipeline->list;
+	tunnel = pipeline->tunnel;
 
-	if((in = fopen(video->filename, "rb")) == NULL)
-		return -2;
+	// open the file while OMX starts up
+	start_prefetch(&prefetch, video->filename);
 
+	startup_phase_begin(STARTUP_PHASE_OMX_INIT);
 	if((client = ilclient_init()) == NULL)
 	{
-		fclose(in);
+		if((in = finish_prefetch(&prefetch)) != NULL)
+			fclose(in);
+		free_pipeline(pipeline);
 		return -3;
 	}
 
 	if(OMX_Init() != OMX_ErrorNone)
 	{
 		ilclient_destroy(client);
-		fclose(in);
+		if((in = finish_prefetch(&prefetch)) != NULL)
+			fclose(in);
+		free_pipeline(pipeline);
 		return -4;
 	}
+	pipeline->client = client;
+	startup_phase_end(STARTUP_PHASE_OMX_INIT);
+	startup_phase_begin(STARTUP_PHASE_COMPONENTS);
 
 	// callback
 	ilclient_set_fill_buffer_done_callback(client, my_fill_buffer_done, 0);
@@ -147,6 +711,7 @@ static int video_decode(VIDEO_THREAD_DATA_T *video) {
 	if(ilclient_create_component(client, &video_decode, "video_decode", ILCLIENT_DISABLE_ALL_PORTS | ILCLIENT_ENABLE_INPUT_BUFFERS) != 0)
 		status = -14;
 	list[0] = video_decode;
+	pipeline->decoder = video_decode;
 
 	// EGL Renderer
 	if(status == 0 && ilclient_create_component(client, &egl_render, "egl_render", ILCLIENT_DISABLE_ALL_PORTS | ILCLIENT_ENABLE_OUTPUT_BUFFERS) != 0)
@@ -193,6 +758,21 @@ static int video_decode(VIDEO_THREAD_DATA_T *video) {
 		OMX_SetParameter(ILC_GET_HANDLE(video_decode), OMX_IndexParamVideoPortFormat, &format) == OMX_ErrorNone &&
 		ilclient_enable_port_buffers(video_decode, 130, NULL, NULL, NULL) != 0)
 		status = -16;
+	startup_phase_end(STARTUP_PHASE_COMPONENTS);
+
+	if((in = finish_prefetch(&prefetch)) == NULL && status == 0)
+		status = -2;
+
+	// a restarted pipeline picks up where the last one could be resumed
+	if(in != NULL && position.offset > 0 && fseeko(in, position.offset, SEEK_SET) != 0)
+		status = -2;
+
+	if(in != NULL && trace_enabled())
+	{
+		struct stat st;
+		if(fstat(fileno(in), &st) == 0)
+			trace_record(TRACE_FILE, (int32_t)(st.st_size & 0xFFFFFFFF), (int32_t)(st.st_size >> 32));
+	}
 
 	if (status == 0) {
 		OMX_BUFFERHEADERTYPE *buf;
@@ -200,9 +780,15 @@ static int video_decode(VIDEO_THREAD_DATA_T *video) {
 		int first_packet = 1;
 
 		ilclient_change_component_state(video_decode, OMX_StateExecuting);
+		pipelineFrames = 0;
+		watchdog_arm_input(&video->watchdog, 1);
 
-		while((buf = ilclient_get_input_buffer(video_decode, 130, 1)) != NULL)
+		while((buf = next_input_buffer(video, video_decode)) != NULL)
 		{
+			if(buffersFed == 0)
+				trace_record(TRACE_INPUT, buf->nAllocLen, 0);
+			trace_command(video);
+
 			pause_if_necessary(video);
 
 			devamp_if_necessary(video, in);
@@ -214,15 +800,20 @@ static int video_decode(VIDEO_THREAD_DATA_T *video) {
 
 			// feed data and wait until we get port settings changed
 			unsigned char *dest = buf->pBuffer;
+			// only the first buffer starts the phase, don't pay for it on the rest
+			if(port_settings_changed == 0)
+				startup_phase_begin(STARTUP_PHASE_PORT_SETTINGS);
 
-			data_len += fread(dest, 1, buf->nAllocLen-data_len, in);
+			unsigned int read_len = fread(dest, 1, buf->nAllocLen-data_len, in);
+			data_len += read_len;
+			trace_record(TRACE_READ, read_len, buffersFed);
 
 			if(port_settings_changed == 0 &&
 				((data_len > 0 && ilclient_remove_event(video_decode, OMX_EventPortSettingsChanged, 131, 0, 0, 1) == 0) ||
-				 (data_len == 0 && ilclient_wait_for_event(video_decode, OMX_EventPortSettingsChanged, 131, 0, 0, 1,
-																		 ILCLIENT_EVENT_ERROR | ILCLIENT_PARAMETER_CHANGED, 10000) == 0)))
+				 (data_len == 0 && wait_for_port_settings(video, video_decode) == 0)))
 			{
 				port_settings_changed = 1;
+				startup_phase_end(STARTUP_PHASE_PORT_SETTINGS);
 
 				if(ilclient_setup_tunnel(tunnel, 0, 0) != 0)
 				{
@@ -242,18 +833,14 @@ static int video_decode(VIDEO_THREAD_DATA_T *video) {
 				// Set egl_render to idle
 				ilclient_change_component_state(egl_render, OMX_StateIdle);
 
-				// Enable the output port and tell egl_render to use the texture as a buffer
-				//ilclient_enable_port(egl_render, 221); THIS BLOCKS SO CANT BE USED
-				if (OMX_SendCommand(ILC_GET_HANDLE(egl_render), OMX_CommandPortEnable, 221, NULL) != OMX_ErrorNone)
-				{
-					printf("OMX_CommandPortEnable failed.\n");
-					exit(1);
-				}
-
-				if (OMX_UseEGLImage(ILC_GET_HANDLE(egl_render), &eglBuffer, 221, NULL, video->eglImage) != OMX_ErrorNone)
+				// Enable the output port and tell egl_render to use the cached textures as buffers
+				watchdog_arm_input(&video->watchdog, 0);
+				wait_for_textures(video);
+				if (use_frame_cache(video) != 0)
 				{
 					printf("OMX_UseEGLImage failed.\n");
-					return -1;
+					status = -1;
+					break;
 				}
 
 				// Set egl_render to executing
@@ -261,11 +848,16 @@ static int video_decode(VIDEO_THREAD_DATA_T *video) {
 
 
 				// Request egl_render to write data to the texture buffer
-				if(OMX_FillThisBuffer(ILC_GET_HANDLE(egl_render), eglBuffer) != OMX_ErrorNone)
+				fillPending = 0;
+				outputRunning = 1;
+				if(fill_next_frame(video) != 0)
 				{
 					printf("OMX_FillThisBuffer failed.\n");
-					return -4;
+					watchdog_fail(&video->watchdog, WATCHDOG_FILL_FAILED);
+					break;
 				}
+				watchdog_arm_input(&video->watchdog, 1);
+				watchdog_arm_output(&video->watchdog, 1);
 			}
 			if(!data_len)
 				break;
@@ -282,39 +874,42 @@ static int video_decode(VIDEO_THREAD_DATA_T *video) {
 			else
 				buf->nFlags = OMX_BUFFERFLAG_TIME_UNKNOWN;
 
+			// the buffer belongs to the decoder once it has been emptied
+			scan_fed_data(&position, dest, buf->nFilledLen);
 			if(OMX_EmptyThisBuffer(ILC_GET_HANDLE(video_decode), buf) != OMX_ErrorNone)
 			{
+				watchdog_fail(&video->watchdog, WATCHDOG_EMPTY_FAILED);
 				status = -6;
 				break;
 			}
+			buffersFed++;
 		}
 
-		buf->nFilledLen = 0;
-		buf->nFlags = OMX_BUFFERFLAG_TIME_UNKNOWN | OMX_BUFFERFLAG_EOS;
+		watchdog_arm_input(&video->watchdog, 0);
+		watchdog_arm_output(&video->watchdog, 0);
+		outputRunning = 0;
 
-		if(OMX_EmptyThisBuffer(ILC_GET_HANDLE(video_decode), buf) != OMX_ErrorNone)
-			status = -20;
+		// a stalled decoder gets no end of stream, it is about to be torn down
+		if(watchdog_fired(&video->watchdog) != WATCHDOG_NONE)
+			status = STATUS_STALLED;
+		else if(buf != NULL)
+		{
+			buf->nFilledLen = 0;
+			buf->nFlags = OMX_BUFFERFLAG_TIME_UNKNOWN | OMX_BUFFERFLAG_EOS;
 
-		// need to flush the renderer to allow video_decode to disable its input port
-		ilclient_flush_tunnels(tunnel, 0);
+			if(OMX_EmptyThisBuffer(ILC_GET_HANDLE(video_decode), buf) != OMX_ErrorNone)
+				status = -20;
+		}
 
-		ilclient_disable_port_buffers(video_decode, 130, NULL, NULL, NULL);
+		pipeline->portBuffers = 1;
 	}
 
-	fclose(in);
-
-	ilclient_disable_tunnel(tunnel);
-	ilclient_disable_tunnel(tunnel+1);
-	ilclient_disable_tunnel(tunnel+2);
-	ilclient_teardown_tunnels(tunnel);
-
-	ilclient_state_transition(list, OMX_StateIdle);
-	ilclient_state_transition(list, OMX_StateLoaded);
-
-	ilclient_cleanup_components(list);
+	if(in != NULL)
+		fclose(in);
 
-	OMX_Deinit();
+	// decoded frames stay in the cache so the renderer can hold the last one
+	frame_cache_detach_buffers(video->cache);
 
-	ilclient_destroy(client);
+	teardown_pipeline(video, pipeline);
 	return status;
 }
@@ -6,18 +6,38 @@
 #define VIDEO_COMMAND_PAUSE 2
 #define VIDEO_COMMAND_DEVAMP 3
 #define VIDEO_COMMAND_TERMINATE 4
+// served from the frame cache, the decoder stops feeding input as for PAUSE
+#define VIDEO_COMMAND_STEP_FORWARD 5
+#define VIDEO_COMMAND_STEP_BACK 6
+#define VIDEO_COMMAND_REVERSE 7
 
 #define VIDEO_STATE_PLAYING 0
 #define VIDEO_STATE_STOPPED 1 
 #define VIDEO_STATE_PAUSED 2
 #define VIDEO_STATE_TERMINATED 3
 
+#include <pthread.h>
+
+#include "framecache.h"
+#include "watchdog.h"
+
 void* video_decode_main(void* arg);
 
 typedef struct
 {
    char *filename;
-   void *eglImage;
+   FRAME_CACHE_T *cache;
    int command;
    int state;
-} VIDEO_THREAD_DATA_T;
\ No newline at end of file
+   // set once the renderer has created the frame cache textures
+   int texturesReady;
+   pthread_mutex_t lock;
+   pthread_cond_t texturesCond;
+   // called instead of sleeping while paused, NULL in the player
+   void (*idle)(void *video);
+   // restarts the decode pipeline when it stops making progress
+   WATCHDOG_T watchdog;
+} VIDEO_THREAD_DATA_T;
+
+void video_init(VIDEO_THREAD_DATA_T *video, char *filename, FRAME_CACHE_T *cache);
+void video_textures_ready(VIDEO_THREAD_DATA_T *video);
\ No newline at end of file
@@ -0,0 +1,211 @@
+// Decoder stall watchdog, see watchdog.h
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "watchdog.h"
+
+// how often the deadlines are checked
+#define WATCHDOG_POLL_NANOS 20000000L
+
+static const char *reasons[WATCHDOG_REASON_COUNT] =
+{
+  "none",
+  "input stalled",
+  "output stalled",
+  "OMX_EmptyThisBuffer failed",
+  "OMX_FillThisBuffer failed"
+};
+
+double watchdog_seconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_nsec / 1000000000 + (double)t.tv_sec;
+}
+
+const char *watchdog_reason(int reason)
+{
+  return reason >= 0 && reason < WATCHDOG_REASON_COUNT ? reasons[reason] : "unknown";
+}
+
+static void fire_locked(WATCHDOG_T *watchdog, int reason, double now)
+{
+  if (watchdog->fired != WATCHDOG_NONE)
+    return;
+  watchdog->fired = reason;
+  watchdog->firedSeconds = now;
+  watchdog->inputArmed = 0;
+  watchdog->outputArmed = 0;
+  watchdog->stats.stalls++;
+  watchdog->stats.lastReason = reason;
+  printf("Watchdog: %s, restarting decoder\n", reasons[reason]);
+}
+
+static void *watchdog_main(void *arg)
+{
+  WATCHDOG_T *watchdog = arg;
+  struct timespec until;
+
+  pthread_mutex_lock(&watchdog->lock);
+  while (watchdog->running)
+  {
+    double now = watchdog_seconds();
+    if (watchdog->inputArmed && now - watchdog->lastInput > watchdog->inputTimeout)
+      fire_locked(watchdog, WATCHDOG_INPUT_STALLED, now);
+    else if (watchdog->outputArmed && now - watchdog->lastOutput > watchdog->outputTimeout)
+      fire_locked(watchdog, WATCHDOG_OUTPUT_STALLED, now);
+
+    clock_gettime(CLOCK_MONOTONIC, &until);
+    until.tv_nsec += WATCHDOG_POLL_NANOS;
+    if (until.tv_nsec >= 1000000000L)
+    {
+      until.tv_sec++;
+      until.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&watchdog->wake, &watchdog->lock, &until);
+  }
+  pthread_mutex_unlock(&watchdog->lock);
+  return NULL;
+}
+
+/***********************************************************
+ * Name: watchdog_init
+ *
+ * Arguments:
+ *       WATCHDOG_T *watchdog - watchdog to set up
+ *       double inputTimeout - longest wait for the decoder to take a buffer
+ *       double outputTimeout - longest wait for egl_render to fill a frame
+ *       double teardownTimeout - longest wait for a pipeline to come down
+ *
+ * Description:   Sets up a disarmed watchdog. The timeouts may be changed
+ *                until watchdog_start() is called.
+ *
+ * Returns: void
+ *
+ ***********************************************************/
+void watchdog_init(WATCHDOG_T *watchdog, double inputTimeout, double outputTimeout, double teardownTimeout)
+{
+  pthread_condattr_t attr;
+
+  memset(watchdog, 0, sizeof(*watchdog));
+  watchdog->inputTimeout = inputTimeout;
+  watchdog->outputTimeout = outputTimeout;
+  watchdog->teardownTimeout = teardownTimeout;
+  pthread_mutex_init(&watchdog->lock, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&watchdog->wake, &attr);
+  pthread_condattr_destroy(&attr);
+}
+
+int watchdog_start(WATCHDOG_T *watchdog)
+{
+  watchdog->running = 1;
+  if (pthread_create(&watchdog->thread, NULL, watchdog_main, watchdog) != 0)
+  {
+    watchdog->running = 0;
+    return -1;
+  }
+  return 0;
+}
+
+void watchdog_stop(WATCHDOG_T *watchdog)
+{
+  if (!watchdog->running)
+    return;
+  pthread_mutex_lock(&watchdog->lock);
+  watchdog->running = 0;
+  pthread_cond_signal(&watchdog->wake);
+  pthread_mutex_unlock(&watchdog->lock);
+  pthread_join(watchdog->thread, NULL);
+}
+
+// Deadlines only apply while the decoder expects progress, so the input
+// side is disarmed while paused and the output side until egl_render has
+// its buffers. Arming starts the clock afresh.
+void watchdog_arm_input(WATCHDOG_T *watchdog, int armed)
+{
+  pthread_mutex_lock(&watchdog->lock);
+  watchdog->inputArmed = armed && watchdog->fired == WATCHDOG_NONE;
+  watchdog->lastInput = watchdog_seconds();
+  pthread_mutex_unlock(&watchdog->lock);
+}
+
+void watchdog_arm_output(WATCHDOG_T *watchdog, int armed)
+{
+  pthread_mutex_lock(&watchdog->lock);
+  watchdog->outputArmed = armed && watchdog->fired == WATCHDOG_NONE;
+  watchdog->lastOutput = watchdog_seconds();
+  pthread_mutex_unlock(&watchdog->lock);
+}
+
+void watchdog_input(WATCHDOG_T *watchdog)
+{
+  pthread_mutex_lock(&watchdog->lock);
+  watchdog->lastInput = watchdog_seconds();
+  pthread_mutex_unlock(&watchdog->lock);
+}
+
+void watchdog_output(WATCHDOG_T *watchdog)
+{
+  double now = watchdog_seconds();
+
+  pthread_mutex_lock(&watchdog->lock);
+  watchdog->lastOutput = now;
+  if (watchdog->recovering && watchdog->fired == WATCHDOG_NONE)
+  {
+    double taken = now - watchdog->firedSeconds;
+    watchdog->recovering = 0;
+    watchdog->stats.recoveries++;
+    watchdog->stats.lastRecoverySeconds = taken;
+    if (taken > watchdog->stats.worstRecoverySeconds)
+      watchdog->stats.worstRecoverySeconds = taken;
+    printf("Watchdog: decoder recovered in %.3fs\n", taken);
+  }
+  pthread_mutex_unlock(&watchdog->lock);
+}
+
+void watchdog_fail(WATCHDOG_T *watchdog, int reason)
+{
+  pthread_mutex_lock(&watchdog->lock);
+  fire_locked(watchdog, reason, watchdog_seconds());
+  pthread_mutex_unlock(&watchdog->lock);
+}
+
+// The decode thread gave up waiting for a pipeline to come down.
+void watchdog_abandoned(WATCHDOG_T *watchdog)
+{
+  pthread_mutex_lock(&watchdog->lock);
+  watchdog->stats.abandoned++;
+  pthread_mutex_unlock(&watchdog->lock);
+  printf("Watchdog: decoder teardown timed out, abandoning it\n");
+}
+
+int watchdog_fired(WATCHDOG_T *watchdog)
+{
+  int fired;
+
+  pthread_mutex_lock(&watchdog->lock);
+  fired = watchdog->fired;
+  pthread_mutex_unlock(&watchdog->lock);
+  return fired;
+}
+
+// The old pipeline is gone and a new one is being built. Deadlines stay
+// disarmed until the decoder arms them again.
+void watchdog_restarted(WATCHDOG_T *watchdog)
+{
+  pthread_mutex_lock(&watchdog->lock);
+  watchdog->fired = WATCHDOG_NONE;
+  watchdog->recovering = 1;
+  pthread_mutex_unlock(&watchdog->lock);
+}
+
+void watchdog_get_stats(WATCHDOG_T *watchdog, WATCHDOG_STATS_T *stats)
+{
+  pthread_mutex_lock(&watchdog->lock);
+  *stats = watchdog->stats;
+  pthread_mutex_unlock(&watchdog->lock);
+}
@@ -0,0 +1,69 @@
+// Decoder stall watchdog.
+//
+// The decoder reports progress as it goes: every input buffer the decoder
+// accepts and every frame egl_render fills. A thread checks those against
+// a deadline for each and fires when one is missed, or straight away when
+// the decoder reports a failure. The decode thread polls watchdog_fired()
+// between its short waits, tears the pipeline down and builds a new one.
+// The first frame after that marks the recovery. Teardown has a deadline
+// too: a pipeline that does not come down in time is abandoned and a
+// fresh one built beside it.
+#pragma once
+
+#include <pthread.h>
+
+#define WATCHDOG_NONE 0
+#define WATCHDOG_INPUT_STALLED 1
+#define WATCHDOG_OUTPUT_STALLED 2
+#define WATCHDOG_EMPTY_FAILED 3
+#define WATCHDOG_FILL_FAILED 4
+#define WATCHDOG_REASON_COUNT 5
+
+typedef struct
+{
+  unsigned long stalls;
+  unsigned long recoveries;
+  // from firing to the first frame out of the new pipeline
+  double lastRecoverySeconds;
+  double worstRecoverySeconds;
+  int lastReason;
+  // pipelines left behind because their teardown did not finish
+  unsigned long abandoned;
+} WATCHDOG_STATS_T;
+
+typedef struct
+{
+  double inputTimeout;
+  double outputTimeout;
+  double teardownTimeout;
+  int inputArmed;
+  int outputArmed;
+  double lastInput;
+  double lastOutput;
+  int fired;
+  double firedSeconds;
+  int recovering;
+  WATCHDOG_STATS_T stats;
+  int running;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+} WATCHDOG_T;
+
+void watchdog_init(WATCHDOG_T *watchdog, double inputTimeout, double outputTimeout, double teardownTimeout);
+int watchdog_start(WATCHDOG_T *watchdog);
+void watchdog_stop(WATCHDOG_T *watchdog);
+
+void watchdog_arm_input(WATCHDOG_T *watchdog, int armed);
+void watchdog_arm_output(WATCHDOG_T *watchdog, int armed);
+void watchdog_input(WATCHDOG_T *watchdog);
+void watchdog_output(WATCHDOG_T *watchdog);
+void watchdog_fail(WATCHDOG_T *watchdog, int reason);
+void watchdog_abandoned(WATCHDOG_T *watchdog);
+
+int watchdog_fired(WATCHDOG_T *watchdog);
+void watchdog_restarted(WATCHDOG_T *watchdog);
+const char *watchdog_reason(int reason);
+double watchdog_seconds(void);
+
+void watchdog_get_stats(WATCHDOG_T *watchdog, WATCHDOG_STATS_T *stats);